@@ -0,0 +1,446 @@
+#include <bit>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+#include <unordered_map>
+
+#include "Cache.h"
+#include "../Types/Symbols.h"
+
+using namespace lox;
+using namespace lox::cache;
+using namespace lox::Types;
+
+namespace {
+
+constexpr char MAGIC[4] = {'L', 'O', 'X', 'C'};
+
+// Appends plain data to a byte buffer. Cache files are only read by the
+// build that wrote them or one with the same VERSION, so values are stored
+// in native byte order.
+class Writer {
+  public:
+    std::string out;
+    // cleared when the program holds something that can not be stored
+    bool ok = true;
+
+    template <class T> auto scalar(T value) -> void {
+        static_assert(std::is_trivially_copyable_v<T>);
+        out.append(reinterpret_cast<const char *>(&value), sizeof(T));
+    }
+    template <class T> auto array(const std::vector<T> &values) -> void {
+        static_assert(std::is_trivially_copyable_v<T>);
+        scalar<uint32_t>(values.size());
+        out.append(reinterpret_cast<const char *>(values.data()),
+                   values.size() * sizeof(T));
+    }
+    auto string(std::string_view str) -> void {
+        scalar<uint32_t>(str.size());
+        out.append(str);
+    }
+};
+
+// Reads back what Writer wrote. Running past the end clears ok and yields
+// zeros, so a damaged file is noticed once at the end of loading.
+class Reader {
+    const char *at;
+    const char *end;
+
+  public:
+    bool ok = true;
+
+    Reader(std::string_view bytes)
+        : at(bytes.data()), end(bytes.data() + bytes.size()) {}
+
+    auto left() const -> size_t { return end - at; }
+
+    auto take(size_t size) -> const char * {
+        if (!ok or left() < size) {
+            ok = false;
+            return nullptr;
+        }
+        auto bytes = at;
+        at += size;
+        return bytes;
+    }
+    template <class T> auto scalar() -> T {
+        T value{};
+        if (auto bytes = take(sizeof(T)))
+            std::memcpy(&value, bytes, sizeof(T));
+        return value;
+    }
+    template <class T> auto array(std::vector<T> &values) -> void {
+        auto count = scalar<uint32_t>();
+        if (auto bytes = take((size_t)count * sizeof(T))) {
+            values.resize(count);
+            std::memcpy(values.data(), bytes, (size_t)count * sizeof(T));
+        }
+    }
+    auto string() -> std::string_view {
+        auto size = scalar<uint32_t>();
+        auto bytes = take(size);
+        return bytes ? std::string_view(bytes, size) : std::string_view();
+    }
+};
+
+// Symbol ids of the writing run, numbered in order of first use.
+class Names {
+    std::unordered_map<int, int32_t> indices;
+
+  public:
+    std::vector<int> symbols;
+
+    auto operator()(int symbol) -> int32_t {
+        if (symbol < 0)
+            return -1;
+        auto [it, inserted] = indices.try_emplace(symbol, (int32_t)symbols.size());
+        if (inserted)
+            symbols.push_back(symbol);
+        return it->second;
+    }
+
+    auto write(Writer &out) const -> void {
+        out.scalar<uint32_t>(symbols.size());
+        for (int symbol : symbols)
+            out.string(Symbols::name(symbol));
+    }
+};
+
+// Symbol ids of the loading run, indexed like Names::symbols.
+auto readNames(Reader &in) -> std::vector<int> {
+    std::vector<int> symbols(std::min<size_t>(in.scalar<uint32_t>(), in.left()));
+    for (auto &symbol : symbols)
+        symbol = Symbols::intern(in.string());
+    return symbols;
+}
+
+auto remap(const std::vector<int> &symbols, int32_t index) -> int32_t {
+    if (index < 0 or (size_t)index >= symbols.size())
+        return -1;
+    return symbols[index];
+}
+
+auto writeFunction(Writer &out, Names &names, const Source &source,
+                   vm::Function *function) -> void;
+
+auto writeValue(Writer &out, Names &names, const Source *source,
+                const Value &value) -> void {
+    out.scalar<uint8_t>(value.kind());
+    switch (value.kind()) {
+    case Value::DOUBLE: out.scalar(value.asDouble()); break;
+    case Value::NIL: break;
+    case Value::BOOL: out.scalar<uint8_t>(value.asBool()); break;
+    case Value::INT: out.scalar<int32_t>(value.asInt()); break;
+    case Value::BYTE: out.scalar<uint8_t>(value.asByte()); break;
+    case Value::CHAR: out.scalar<char>(value.asChar()); break;
+    case Value::STRING: out.string(value.asString()); break;
+    case Value::CALLABLE: {
+        // only functions compiled from this script can be stored
+        auto function = dynamic_cast<vm::Function *>(value.asCallable());
+        if (function and source and !function->declaration)
+            writeFunction(out, names, *source, function);
+        else
+            out.ok = false;
+        break;
+    }
+    }
+}
+
+// Nothing owns a function read back, nor the functions among its
+// constants, until the script is handed to the VM.
+struct FunctionDeleter {
+    auto operator()(vm::Function *function) const -> void {
+        for (auto &constant : function->chunk.constants)
+            if (constant.isCallable())
+                (*this)(static_cast<vm::Function *>(constant.asCallable()));
+        delete function;
+    }
+};
+using FunctionPtr = std::unique_ptr<vm::Function, FunctionDeleter>;
+
+auto readFunction(Reader &in, const std::vector<int> &symbols,
+                  const Source &source) -> FunctionPtr;
+
+auto readValue(Reader &in, const std::vector<int> &symbols,
+               const Source *source) -> Value {
+    switch (in.scalar<uint8_t>()) {
+    case Value::DOUBLE: return in.scalar<double>();
+    case Value::NIL: return nullptr;
+    case Value::BOOL: return (bool)in.scalar<uint8_t>();
+    case Value::INT: return in.scalar<int32_t>();
+    case Value::BYTE: return in.scalar<uint8_t>();
+    case Value::CHAR: return in.scalar<char>();
+    case Value::STRING: return std::string(in.string());
+    case Value::CALLABLE:
+        // owned by the function whose constant it is from here on
+        if (source)
+            return readFunction(in, symbols, *source).release();
+    }
+    in.ok = false;
+    return nullptr;
+}
+
+auto writeFunction(Writer &out, Names &names, const Source &source,
+                   vm::Function *function) -> void {
+    auto &chunk = function->chunk;
+    out.string(function->name);
+    out.scalar<int32_t>(function->params);
+    out.array(chunk.code);
+    out.array(chunk.lines);
+
+    out.scalar<uint32_t>(chunk.constants.size());
+    for (auto &constant : chunk.constants)
+        writeValue(out, names, &source, constant);
+
+    // lexemes are cut from the source again on load, which only works for
+    // tokens that point into it
+    auto text = source.text();
+    out.scalar<uint32_t>(chunk.tokens.size());
+    for (auto &token : chunk.tokens) {
+        auto lexeme = token.lexeme();
+        if (lexeme.data() < text.data() or lexeme.size() > UINT16_MAX or
+            lexeme.data() + lexeme.size() > text.data() + text.size()) {
+            out.ok = false;
+            return;
+        }
+        out.scalar(flat::TokenRecord{(uint32_t)(lexeme.data() - text.data()),
+                                     (uint32_t)token.line(), names(token.symbol()),
+                                     (uint16_t)lexeme.size(), (uint8_t)token.type()});
+    }
+}
+
+auto readFunction(Reader &in, const std::vector<int> &symbols,
+                  const Source &source) -> FunctionPtr {
+    FunctionPtr function(new vm::Function(std::string(in.string())));
+    auto &chunk = function->chunk;
+    function->params = in.scalar<int32_t>();
+    in.array(chunk.code);
+    in.array(chunk.lines);
+
+    auto constants = std::min<size_t>(in.scalar<uint32_t>(), in.left());
+    chunk.constants.reserve(constants);
+    for (size_t i = 0; i < constants and in.ok; ++i)
+        chunk.constants.push_back(readValue(in, symbols, &source));
+
+    auto text = source.text();
+    auto tokens = std::min<size_t>(in.scalar<uint32_t>(), in.left());
+    chunk.tokens.reserve(tokens);
+    for (size_t i = 0; i < tokens and in.ok; ++i) {
+        auto record = in.scalar<flat::TokenRecord>();
+        if ((size_t)record.offset + record.length > text.size()) {
+            in.ok = false;
+            break;
+        }
+        chunk.tokens.emplace_back(TokenType(record.type),
+                                  text.substr(record.offset, record.length), -1,
+                                  record.line, record.offset, record.length,
+                                  remap(symbols, record.symbol));
+    }
+    return function;
+}
+
+auto hashBytes(std::string_view bytes, uint64_t seed) -> uint64_t {
+    constexpr uint64_t K = 0x9e3779b97f4a7c15;
+    auto mix = [](uint64_t h) {
+        h = (h ^ (h >> 33)) * 0xff51afd7ed558ccd;
+        h = (h ^ (h >> 33)) * 0xc4ceb9fe1a85ec53;
+        return h ^ (h >> 33);
+    };
+
+    // four independent lanes keep the multiplier busy
+    uint64_t lanes[4] = {seed, seed ^ K, seed + K, seed - K};
+    const char *at = bytes.data();
+    size_t size = bytes.size();
+    for (; size >= 32; at += 32, size -= 32)
+        for (int i = 0; i < 4; ++i) {
+            uint64_t word;
+            std::memcpy(&word, at + 8 * i, 8);
+            lanes[i] = std::rotl((lanes[i] ^ word) * K, 31);
+        }
+    for (; size > 0; at += 8, size -= std::min<size_t>(size, 8)) {
+        uint64_t word = 0;
+        std::memcpy(&word, at, std::min<size_t>(size, 8));
+        lanes[0] = std::rotl((lanes[0] ^ word) * K, 31);
+    }
+
+    uint64_t h = bytes.size();
+    for (auto lane : lanes)
+        h = mix(h ^ lane);
+    return h;
+}
+
+// header: magic, version, engine, key, payload hash, payload size
+constexpr size_t HEADER = sizeof MAGIC + 4 + 4 + 8 + 8 + 8;
+
+auto write(const std::string &path, uint64_t key, Engine engine,
+           const Writer &payload) -> void {
+    if (!payload.ok)
+        return;
+
+    Writer header;
+    header.out.append(MAGIC, sizeof MAGIC);
+    header.scalar<uint32_t>(VERSION);
+    header.scalar<uint32_t>(engine);
+    header.scalar<uint64_t>(key);
+    header.scalar<uint64_t>(hashBytes(payload.out, VERSION));
+    header.scalar<uint64_t>(payload.out.size());
+
+    // a concurrent run never sees a half written file
+    std::string temporary = path + ".tmp";
+    std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+    file.write(header.out.data(), header.out.size());
+    file.write(payload.out.data(), payload.out.size());
+    file.close();
+    if (!file or std::rename(temporary.c_str(), path.c_str()) != 0)
+        std::remove(temporary.c_str());
+}
+
+// payload of a valid cache file, empty when there is none
+auto read(const std::string &path, uint64_t key, Engine engine)
+    -> std::pair<std::shared_ptr<Source>, std::string_view> {
+    auto file = Source::open(path);
+    if (!file or file->text().size() < HEADER)
+        return {};
+
+    Reader header(file->text().substr(0, HEADER));
+    auto bytes = header.take(sizeof MAGIC);
+    if (std::memcmp(bytes, MAGIC, sizeof MAGIC) != 0 or
+        header.scalar<uint32_t>() != VERSION or
+        header.scalar<uint32_t>() != engine or header.scalar<uint64_t>() != key)
+        return {};
+
+    auto checksum = header.scalar<uint64_t>();
+    auto payload = file->text().substr(HEADER);
+    if (header.scalar<uint64_t>() != payload.size() or
+        hashBytes(payload, VERSION) != checksum)
+        return {};
+    return {std::move(file), payload};
+}
+
+} // namespace
+
+auto cache::hash(std::string_view text, bool optimized) -> uint64_t {
+    return hashBytes(text, optimized);
+}
+
+auto cache::path(const std::string &script, uint64_t key, bool optimized,
+                 Engine engine) -> std::string {
+    std::string suffix = engine == TREE ? ".tree.loxc" : ".vm.loxc";
+    if (optimized)
+        suffix = ".O" + suffix;
+    auto dir = std::getenv("LOX_CACHE_DIR");
+    if (!dir or !*dir)
+        return script + suffix;
+
+    char name[17];
+    std::snprintf(name, sizeof name, "%016llx", (unsigned long long)key);
+    return std::string(dir) + "/" + name + suffix;
+}
+
+auto cache::save(const std::string &path, uint64_t key, const flat::Tree &tree)
+    -> void {
+    Names names;
+    Writer body;
+
+    // the three fixed entries are present in every pool
+    body.scalar<uint32_t>(tree.constants->size());
+    for (size_t i = Constants::TRUE + 1; i < tree.constants->size(); ++i)
+        writeValue(body, names, nullptr, (*tree.constants)[i]);
+
+    auto tokens = tree.tokens;
+    for (auto &token : tokens)
+        token.symbol = names(token.symbol);
+
+    body.scalar<uint32_t>(tree.statements);
+    body.array(tree.nodes);
+    body.array(tokens);
+    body.array(tree.lists);
+
+    // names go first so that loading can intern them before the tokens
+    Writer payload;
+    names.write(payload);
+    payload.out += body.out;
+    payload.ok = body.ok;
+    write(path, key, TREE, payload);
+}
+
+auto cache::save(const std::string &path, uint64_t key, const vm::VM &vm,
+                 vm::Function *script, const Source &source) -> void {
+    Names names;
+    Writer body;
+
+    // the bytecode refers to globals by slot, which the loading run has to
+    // hand out in the same order
+    body.scalar<uint32_t>(vm.globalCount());
+    for (int slot = 0; slot < vm.globalCount(); ++slot)
+        body.scalar<int32_t>(names(vm.globalSymbol(slot)));
+
+    writeFunction(body, names, source, script);
+
+    Writer payload;
+    names.write(payload);
+    payload.out += body.out;
+    payload.ok = body.ok;
+    write(path, key, VM, payload);
+}
+
+auto cache::loadTree(const std::string &path, uint64_t key,
+                     std::shared_ptr<const Source> source)
+    -> std::unique_ptr<flat::Tree> {
+    auto [file, payload] = read(path, key, TREE);
+    if (!file)
+        return nullptr;
+
+    Reader in(payload);
+    auto symbols = readNames(in);
+
+    auto constants = std::make_shared<Constants>();
+    auto count = in.scalar<uint32_t>();
+    for (size_t i = constants->size(); i < count and in.ok; ++i)
+        constants->add(readValue(in, symbols, nullptr));
+
+    auto tree = std::make_unique<flat::Tree>();
+    tree->statements = in.scalar<uint32_t>();
+    in.array(tree->nodes);
+    in.array(tree->tokens);
+    in.array(tree->lists);
+    if (!in.ok or in.left() != 0 or constants->size() != count)
+        return nullptr;
+
+    auto text = source->text();
+    for (auto &token : tree->tokens) {
+        if ((size_t)token.offset + token.length > text.size())
+            return nullptr;
+        token.symbol = remap(symbols, token.symbol);
+    }
+
+    tree->source = std::move(source);
+    tree->constants = std::move(constants);
+    return tree;
+}
+
+auto cache::loadScript(const std::string &path, uint64_t key, vm::VM &vm,
+                       const Source &source) -> vm::Function * {
+    auto [file, payload] = read(path, key, VM);
+    if (!file)
+        return nullptr;
+
+    Reader in(payload);
+    auto symbols = readNames(in);
+
+    // natives are defined before anything else, so a fresh VM hands out
+    // the same slots as the run that wrote the cache
+    auto globals = in.scalar<uint32_t>();
+    for (uint32_t slot = 0; slot < globals and in.ok; ++slot) {
+        int symbol = remap(symbols, in.scalar<int32_t>());
+        if (symbol < 0 or vm.globalSlot(symbol) != (int)slot)
+            return nullptr;
+    }
+
+    auto script = readFunction(in, symbols, source);
+    if (!in.ok or in.left() != 0)
+        return nullptr;
+    return script.release();
+}
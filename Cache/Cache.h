@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "../Parser/FlatAst.h"
+#include "../Scanner/Source.h"
+#include "../VM/VM.h"
+
+namespace lox::cache {
+
+// Compiled programs saved between runs of the same script, so that an
+// unchanged script skips the Scanner, Parser and Checker. The tree engine
+// stores the checked flat tree, the VM stores the compiled script.
+//
+// A cache file starts with a header (magic, format version, engine, hash of
+// the script text and of the payload) and is read back with a single
+// mapping. Anything that does not match is ignored and the script is
+// compiled as usual. Symbol ids are not stable between runs, so the names
+// a program uses are stored once and interned again on load.
+
+// bumped whenever the format or the meaning of the stored data changes
+inline constexpr uint32_t VERSION = 1;
+
+enum Engine : uint8_t { TREE, VM };
+
+// Fast 64 bit hash of the script text and of whether it is optimized (-O);
+// a cache key, not a checksum against tampering.
+auto hash(std::string_view text, bool optimized) -> uint64_t;
+
+// $LOX_CACHE_DIR/<key>[.O].<engine>.loxc when the variable is set, otherwise
+// <script>[.O].<engine>.loxc next to the script; .O marks an optimized (-O)
+// script, so runs with and without -O keep their own file
+auto path(const std::string &script, uint64_t key, bool optimized, Engine engine)
+    -> std::string;
+
+// Both write to a temporary file and rename it into place, a failure only
+// means that the next run compiles again.
+auto save(const std::string &path, uint64_t key, const flat::Tree &tree) -> void;
+auto save(const std::string &path, uint64_t key, const vm::VM &vm,
+          vm::Function *script, const Source &source) -> void;
+
+// nullptr when there is no usable cache. Tokens of the result point into
+// the source, which has to stay alive as long as they do.
+auto loadTree(const std::string &path, uint64_t key,
+              std::shared_ptr<const Source> source) -> std::unique_ptr<flat::Tree>;
+auto loadScript(const std::string &path, uint64_t key, vm::VM &vm,
+                const Source &source) -> vm::Function *;
+
+} // namespace lox::cache
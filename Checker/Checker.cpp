@@ -1,8 +1,15 @@
+#include <atomic>
 #include <cmath>
 #include <iostream>
+#include <iterator>
+#include <thread>
+#include <tuple>
+#include <utility>
 
 #include "Checker.h"
 #include "../Error/Error.h"
+#include "../Parser/Parser.h"
+#include "../Scanner/Scanner.h"
 
 extern bool hadError;
 extern bool hadRuntimeError;
@@ -15,24 +22,33 @@ auto Checker::check(std::vector<Stmt*> stmts) -> void
 
 auto Checker::consider(Stmt* statement) -> void
 {
-    statement->accept(this);
+    dispatchStmt(statement);
 }
 
 auto Checker::consider(Expr* expr) -> void
 {
-    expr->accept(this);
+    dispatchExpr(expr);
 }
 
 auto Checker::check_declaration(Types::Token name) -> void
 {
     if (!environment->check(name))
-        error(name.line(), "'" + name.lexeme() + "' wasn't declared.");
+        error(name.line(), "'" + std::string(name.lexeme()) + "' wasn't declared.");
 }
 
 auto Checker::check_duplication(Types::Token name) -> void
 {
     if (environment->check_local(name))
-        error(name.line(), "Duplication of '" + name.lexeme() + "'.");
+        error(name.line(), "Duplication of '" + std::string(name.lexeme()) + "'.");
+}
+
+auto Checker::declare(Types::Token name) -> int
+{
+    if (environment == globals) {
+        environment->define(name.symbol(), nullptr);
+        return -1;
+    }
+    return environment->declare(name.symbol());
 }
 
 auto Checker::error(int line, std::string msg) -> void
@@ -57,7 +73,7 @@ auto Checker::visit(VarStmt* stmt) -> void
         consider(stmt->init);
     check_duplication(stmt->name);
 
-    environment->define(stmt->name.lexeme(), nullptr);
+    stmt->slot = declare(stmt->name);
 }
 
 auto Checker::visit(BlockStmt* stmt) -> void
@@ -65,6 +81,8 @@ auto Checker::visit(BlockStmt* stmt) -> void
     LocalEnvironment local(this);
     for (auto statement : stmt->statements)
         consider(statement);
+    // a function body sees only the globals, so no block outlives its run
+    stmt->frame = environment->size();
 }
 
 auto Checker::visit(WhileStmt* stmt) -> void
@@ -85,10 +103,18 @@ auto Checker::visit(FunctionStmt* stmt) -> void
 {
     check_duplication(stmt->name);
 
-    //Function* function = new Function(stmt, new Environment(*environment));
-    Function* function = new Function(stmt);
-    environment->define(stmt->name.lexeme(), function);
+    stmt->slot = declare(stmt->name);
 
+    // the body is checked on the first call, against the globals known then
+    if (stmt->lazy) {
+        stmt->lazy->unit->checker = this;
+        return;
+    }
+    checkBody(stmt);
+}
+
+auto Checker::checkBody(FunctionStmt* stmt) -> void
+{
     // Function scope
     auto saved_env = environment;
     auto back = [&saved_env](Env *env) { std::swap(*env, saved_env); };
@@ -100,11 +126,87 @@ auto Checker::visit(FunctionStmt* stmt) -> void
 
 
     for (auto decl : stmt->params)
-        environment->define(decl.lexeme(), nullptr);
+        environment->declare(decl.symbol());
 
     check(stmt->body);
 }
 
+auto Checker::complete(FunctionStmt* stmt) -> bool
+{
+    auto lazy = stmt->lazy;
+    Scanner scanner(lazy->unit->source, lazy->begin, lazy->end, lazy->line,
+                    lazy->unit->constants);
+    Parser parser(scanner);
+    stmt->body = parser.body(*lazy->unit->arena);
+    checkBody(stmt);
+
+    if (hadError)
+        return false;
+    stmt->lazy = nullptr;
+    return true;
+}
+
+auto Checker::complete(LazyUnit& unit, int jobs, std::vector<ErrorEntry>& parseErrors,
+                       std::vector<ErrorEntry>& checkErrors) -> void
+{
+    struct Result {
+        std::vector<ErrorEntry> parse;
+        std::vector<ErrorEntry> check;
+    };
+
+    auto& functions = unit.functions;
+    std::vector<Result> results(functions.size());
+    std::vector<Arena> arenas(jobs);
+    std::atomic<size_t> next = 0;
+
+    // bodies are handed out one at a time, they differ a lot in size
+    auto work = [&](int worker) {
+        Checker checker(globals);
+        for (size_t i; (i = next++) < functions.size();) {
+            auto stmt = functions[i];
+            auto lazy = stmt->lazy;
+            {
+                ErrorLog log;
+                Scanner scanner(unit.source, lazy->begin, lazy->end, lazy->line,
+                                unit.constants, &unit.lock);
+                Parser parser(scanner);
+                stmt->body = parser.body(arenas[worker]);
+                results[i].parse = std::move(log.entries);
+            }
+            {
+                ErrorLog log;
+                checker.checkBody(stmt);
+                results[i].check = std::move(log.entries);
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (int worker = 1; worker < jobs; ++worker)
+        workers.emplace_back(work, worker);
+    work(0);
+    for (auto& worker : workers)
+        worker.join();
+
+    bool failed = false;
+    for (auto& result : results) {
+        for (auto& error : result.parse)
+            if (error.stage != "Scanner") {
+                parseErrors.push_back(std::move(error));
+                failed = true;
+            }
+        failed = failed or !result.check.empty();
+        std::move(result.check.begin(), result.check.end(), std::back_inserter(checkErrors));
+    }
+
+    for (auto& arena : arenas)
+        unit.arena->adopt(std::move(arena));
+    // bodies with errors stay pending, the program does not run anyway
+    if (!failed)
+        for (auto stmt : functions)
+            stmt->lazy = nullptr;
+}
+
 auto Checker::visit(ReturnStmt* stmt) -> void
 {
     consider(stmt->expr);
@@ -147,12 +249,14 @@ auto Checker::visit(UnaryExpr* expr) -> Lit
 auto Checker::visit(VariableExpr* expr) -> Lit
 {
     check_declaration(expr->name);
+    std::tie(expr->depth, expr->slot) = environment->resolve(expr->name);
     return nullptr;
 }
 
 auto Checker::visit(AssignExpr* expr) -> Lit
 {
     check_declaration(expr->name);
+    std::tie(expr->depth, expr->slot) = environment->resolve(expr->name);
 
     consider(expr->value);
     return nullptr;
@@ -165,3 +269,111 @@ auto Checker::visit(CallExpr* expr) -> Lit
         consider(arg);
     return nullptr;
 }
+
+
+
+// Flat syntax tree
+auto Checker::check(flat::Tree& tree) -> void
+{
+    auto saved_tree = std::exchange(this->tree, &tree);
+    for (auto statement : tree.list(tree.statements))
+        consider(statement);
+    this->tree = saved_tree;
+}
+
+auto Checker::consider(flat::Index index) -> void
+{
+    using namespace flat;
+    if (index == NONE)
+        return;
+
+    auto& node = (*tree)[index];
+    switch (node.kind) {
+    case BINARY:
+    case LOGICAL:
+    case WHILE:
+        consider(node.a);
+        consider(node.b);
+        break;
+
+    case GROUPING:
+    case UNARY:
+    case EXPRESSION:
+    case PRINT:
+    case RETURN:
+        consider(node.a);
+        break;
+
+    case LITERAL:
+        break;
+
+    case VARIABLE: {
+        auto name = tree->token(node.token);
+        check_declaration(name);
+        auto [depth, slot] = environment->resolve(name);
+        node.a = depth;
+        node.b = slot;
+        break;
+    }
+
+    case ASSIGN: {
+        auto name = tree->token(node.token);
+        check_declaration(name);
+        auto [depth, slot] = environment->resolve(name);
+        node.b = depth;
+        node.c = slot;
+        consider(node.a);
+        break;
+    }
+
+    case CALL:
+        consider(node.a);
+        for (auto arg : tree->list(node.b))
+            consider(arg);
+        break;
+
+    case VAR: {
+        consider(node.a);
+        auto name = tree->token(node.token);
+        check_duplication(name);
+        node.b = declare(name);
+        break;
+    }
+
+    case BLOCK: {
+        LocalEnvironment local(this);
+        for (auto statement : tree->list(node.a))
+            consider(statement);
+        node.b = environment->size();
+        break;
+    }
+
+    case IF:
+        consider(node.a);
+        consider(node.b);
+        consider(node.c);
+        break;
+
+    case FUNCTION: {
+        auto name = tree->token(node.token);
+        check_duplication(name);
+        node.c = declare(name);
+
+        // Function scope
+        auto saved_env = environment;
+        auto back = [&saved_env](Env *env) { std::swap(*env, saved_env); };
+        std::unique_ptr<Env, decltype(back)> backup(&environment, back);
+
+        Env env = std::make_shared<Environment>();
+        environment = env;
+        environment->enclosing = globals.get();
+
+        for (Index param = 1; param <= node.a; ++param)
+            environment->declare(tree->tokens[node.token + param].symbol);
+
+        for (auto statement : tree->list(node.b))
+            consider(statement);
+        break;
+    }
+    }
+}
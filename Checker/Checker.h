@@ -1,14 +1,16 @@
 #pragma once
 
 #include "../Environment/Environment.h"
+#include "../Error/Error.h"
 #include "../Interpreter/Interpreter.h"
 #include "../Parser/Expr.h"
+#include "../Parser/FlatAst.h"
 #include "../Parser/Stmt.h"
 #include "../Types/Token.h"
 
 namespace lox {
 
-class Checker : public ExprVisitor, public StmtVisitor {
+class Checker : public ExprStaticVisitor<Checker>, public StmtStaticVisitor<Checker> {
     class LocalEnvironment {
         Checker *checker;
         Env saved_env;
@@ -31,12 +33,17 @@ class Checker : public ExprVisitor, public StmtVisitor {
 
   private:
     Env environment = globals;
+    // flat tree being checked, nodes are resolved in place
+    flat::Tree *tree = nullptr;
 
     auto consider(Stmt *statement) -> void;
     auto consider(Expr *expr) -> void;
+    auto consider(flat::Index node) -> void;
     auto error(int line, std::string msg) -> void;
     auto check_duplication(Types::Token token) -> void;
     auto check_declaration(Types::Token token) -> void;
+    auto declare(Types::Token token) -> int;
+    auto checkBody(FunctionStmt *stmt) -> void;
 
   public:
     Checker() {
@@ -47,27 +54,41 @@ class Checker : public ExprVisitor, public StmtVisitor {
         globals->define("type", new TypeCallable());
     }
 
+    // checker that shares the globals of another
+    explicit Checker(Env globals) : globals(std::move(globals)) {}
+
     auto check(std::vector<Stmt *> stmts) -> void;
+    auto check(flat::Tree &tree) -> void;
+    // Parses and checks the body of a function that the pre-parse skipped,
+    // false when it has errors. They are reported like any other.
+    auto complete(FunctionStmt *stmt) -> bool;
+    // Parses and checks every body the pre-parse skipped on up to jobs
+    // threads, each with its own Checker against the globals declared so
+    // far. Errors are appended to parseErrors and checkErrors, grouped by
+    // function in source order; errors of the Scanner were reported by the
+    // pre-parse already and are dropped.
+    auto complete(LazyUnit &unit, int jobs, std::vector<ErrorEntry> &parseErrors,
+                  std::vector<ErrorEntry> &checkErrors) -> void;
 
     // Expressions
-    auto visit(BinaryExpr *expr) -> Lit override;
-    auto visit(LogicalExpr *expr) -> Lit override;
-    auto visit(GroupingExpr *expr) -> Lit override;
-    auto visit(LiteralExpr *expr) -> Lit override;
-    auto visit(UnaryExpr *expr) -> Lit override;
-    auto visit(VariableExpr *expr) -> Lit override;
-    auto visit(AssignExpr *expr) -> Lit override;
-    auto visit(CallExpr *expr) -> Lit override;
+    auto visit(BinaryExpr *expr) -> Lit;
+    auto visit(LogicalExpr *expr) -> Lit;
+    auto visit(GroupingExpr *expr) -> Lit;
+    auto visit(LiteralExpr *expr) -> Lit;
+    auto visit(UnaryExpr *expr) -> Lit;
+    auto visit(VariableExpr *expr) -> Lit;
+    auto visit(AssignExpr *expr) -> Lit;
+    auto visit(CallExpr *expr) -> Lit;
 
     // Statements
-    auto visit(ExpressionStmt *stmt) -> void override;
-    auto visit(PrintStmt *stmt) -> void override;
-    auto visit(VarStmt *stmt) -> void override;
-    auto visit(BlockStmt *stmt) -> void override;
-    auto visit(WhileStmt *stmt) -> void override;
-    auto visit(IfStmt *stmt) -> void override;
-    auto visit(FunctionStmt *stmt) -> void override;
-    auto visit(ReturnStmt *stmt) -> void override;
+    auto visit(ExpressionStmt *stmt) -> void;
+    auto visit(PrintStmt *stmt) -> void;
+    auto visit(VarStmt *stmt) -> void;
+    auto visit(BlockStmt *stmt) -> void;
+    auto visit(WhileStmt *stmt) -> void;
+    auto visit(IfStmt *stmt) -> void;
+    auto visit(FunctionStmt *stmt) -> void;
+    auto visit(ReturnStmt *stmt) -> void;
 };
 
 } // namespace lox
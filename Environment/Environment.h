@@ -1,9 +1,15 @@
 #pragma once
+#include <array>
+#include <span>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <stdexcept>
 #include <memory>
+#include <utility>
+#include <vector>
 
+#include "../Types/Symbols.h"
 #include "../Types/Token.h"
 
 namespace lox
@@ -20,10 +26,37 @@ public:
 };
 
 
+// Globals are stored by symbol id in a table indexed by the id. Locals live
+// in the indexed storage: the Checker hands out slots in declaration order
+// and records (depth, slot) on every reference. No lookup hashes a name.
 class Environment
 {
     typedef Types::Literal Lit;
-    std::unordered_map<std::string, Lit> values;
+    std::vector<Lit> values;
+    std::vector<bool> defined;
+
+    std::vector<Lit> slots;
+    // the locals: slots, or the storage of a Frame until it is outgrown
+    Lit* locals = nullptr;
+    size_t count = 0;
+    // slot of each declared local by symbol id, only filled by the Checker
+    std::unordered_map<int, int> indices;
+
+    auto grow(size_t size) -> void
+    {
+        if (locals != slots.data())
+            slots.assign(locals, locals + count);
+        slots.resize(size);
+        locals = slots.data();
+        count = size;
+    }
+
+    auto find(int symbol) -> Lit*
+    {
+        if ((size_t) symbol < defined.size() and defined[symbol])
+            return &values[symbol];
+        return nullptr;
+    }
 
 public:
 
@@ -31,16 +64,33 @@ public:
 
     Environment() = default;
     Environment(Environment* enclosing) : enclosing(enclosing) {}
+    // locals in storage the caller owns and keeps alive
+    Environment(Environment* enclosing, std::span<Lit> frame) :
+        locals(frame.data()), count(frame.size()), enclosing(enclosing)
+    {}
+    // a copy would share the storage of the locals
+    Environment(const Environment&) = delete;
+    auto operator=(const Environment&) -> Environment& = delete;
+
+    auto define(int symbol, Lit value) -> void
+    {
+        if ((size_t) symbol >= values.size()) {
+            values.resize(symbol + 1);
+            defined.resize(symbol + 1);
+        }
+        values[symbol] = std::move(value);
+        defined[symbol] = true;
+    }
 
-    auto define(const std::string& name, Lit value) -> void
+    auto define(std::string_view name, Lit value) -> void
     {
-        values[name] = value;
+        define(Types::Symbols::intern(name), std::move(value));
     }
 
     auto assign(const Types::Token& name, Lit value) -> void
     {
-        if (values.contains(name.lexeme())) {
-            values[name.lexeme()] = value;
+        if (auto slot = find(name.symbol())) {
+            *slot = value;
             return;
         }
 
@@ -49,35 +99,113 @@ public:
             return;
         }
 
-        throw RuntimeError(name, "Undefined variable '" + name.lexeme() + "'.");
+        throw RuntimeError(name, "Undefined variable '" + std::string(name.lexeme()) + "'.");
     }
 
     auto get(Types::Token& name) -> Lit
     {
-        if (values.contains(name.lexeme()))
-            return values[name.lexeme()];
+        if (auto slot = find(name.symbol()))
+            return *slot;
 
         if (enclosing) return enclosing->get(name);
 
-        throw RuntimeError(name, "Undefined variable '" + name.lexeme() + "'.");
+        throw RuntimeError(name, "Undefined variable '" + std::string(name.lexeme()) + "'.");
     }
 
     auto check_local(Types::Token& name) -> bool
     {
-        return values.contains(name.lexeme());
+        return find(name.symbol()) or indices.contains(name.symbol());
     }
 
     auto check(Types::Token& name) -> bool
     {
-        if (values.contains(name.lexeme()))
+        if (check_local(name))
             return true;
         if (enclosing)
             return enclosing->check(name);
         return false;
     }
 
+    // Indexed storage
+
+    auto declare(int symbol) -> int
+    {
+        int slot = count;
+        indices.insert_or_assign(symbol, slot);
+        grow(count + 1);
+        return slot;
+    }
+
+    // slots declared so far
+    auto size() const -> int
+    {
+        return count;
+    }
+
+    // Returns {depth, slot} of a local, or {-1, -1} when the name is
+    // a global or not declared at all.
+    auto resolve(const Types::Token& name) -> std::pair<int, int>
+    {
+        int depth = 0;
+        for (auto env = this; env; env = env->enclosing, ++depth) {
+            auto slot = env->indices.find(name.symbol());
+            if (slot != env->indices.end())
+                return {depth, slot->second};
+        }
+        return {-1, -1};
+    }
+
+    auto defineAt(int slot, Lit value) -> void
+    {
+        if ((size_t) slot >= count)
+            grow(slot + 1);
+        locals[slot] = std::move(value);
+    }
+
+    auto ancestor(int depth) -> Environment*
+    {
+        auto env = this;
+        while (depth--)
+            env = env->enclosing;
+        return env;
+    }
+
+    auto getAt(int depth, int slot) -> Lit&
+    {
+        return ancestor(depth)->locals[slot];
+    }
+
+    auto assignAt(int depth, int slot, Lit value) -> void
+    {
+        ancestor(depth)->locals[slot] = std::move(value);
+    }
+
 }; // class Environment
 
 typedef std::shared_ptr<Environment> Env;
 
+// The Environment of a block, with its locals, on the C++ stack of the
+// Interpreter: running the block allocates nothing. Function bodies see only
+// the globals, so nothing refers to a block after it ran. Blocks with more
+// than SIZE locals get a heap Environment instead.
+class Frame
+{
+public:
+    static constexpr int SIZE = 8;
+
+private:
+    std::array<Types::Literal, SIZE> slots;
+    Environment environment;
+
+public:
+    Frame() : environment(nullptr, slots) {}
+
+    // lives as long as the frame; the Interpreter only refers to it while
+    // running the block, see Interpreter::executeBlock()
+    auto env() -> Environment&
+    {
+        return environment;
+    }
+};
+
 } // namespace lox
@@ -4,8 +4,17 @@ using namespace lox;
 extern bool hadError;
 extern bool hadRuntimeError;
 
+thread_local ErrorLog* ErrorLog::current = nullptr;
+
+ErrorLog::ErrorLog() : saved(current) { current = this; }
+ErrorLog::~ErrorLog() { current = saved; }
+
 void lox::report(int line, std::string stage, std::string msg)
 {
+    if (ErrorLog::current) {
+        ErrorLog::current->entries.push_back({line, std::move(stage), std::move(msg)});
+        return;
+    }
     hadError = true;
     std::cerr << "\e[31m[line " << line << "] " + stage + " Error: " << msg << std::endl;
 }
@@ -3,9 +3,34 @@
 #include <exception>
 #include <iostream>
 #include <string>
+#include <vector>
 
 namespace lox
 {
     void report(int line, std::string stage, std::string msg);
     void report(std::ostream& out, int line, std::string stage, std::string msg);
+
+    struct ErrorEntry
+    {
+        int line;
+        std::string stage;
+        std::string msg;
+    };
+
+    // While an ErrorLog is alive, errors reported on its thread are kept in
+    // entries instead of being printed, so that errors found on several
+    // threads can be reported afterwards in a fixed order.
+    class ErrorLog
+    {
+        ErrorLog* saved;
+    public:
+        std::vector<ErrorEntry> entries;
+
+        ErrorLog();
+        ~ErrorLog();
+        ErrorLog(const ErrorLog&) = delete;
+        ErrorLog& operator=(const ErrorLog&) = delete;
+
+        static thread_local ErrorLog* current;
+    };
 }
@@ -1,10 +1,10 @@
 #include "Interpreter.h"
+#include "../Checker/Checker.h"
 #include <cctype>
 #include <cmath>
 #include <stack>
 #include <unordered_map>
 #include <string>
-#include <variant>
 
 using namespace lox;
 using namespace lox::Types;
@@ -12,60 +12,65 @@ using namespace lox::Types;
 auto polish_notation(const std::string& expr) -> std::string;
 
 auto Function::call(Interpreter *interpreter, Token &token,
-                    std::vector<Types::Literal> arguments) -> Types::Literal {
+                    std::span<Types::Value> arguments) -> Types::Value {
+    if (declaration->lazy and !declaration->lazy->unit->checker->complete(declaration))
+        throw RuntimeError(token, "Body of " + toString() + " has errors.");
+
     Env env(new Environment());
 
     for (size_t i{}; i < declaration->params.size(); ++i)
-        env->define(declaration->params[i].lexeme(), arguments[i]);
+        env->defineAt(i, arguments[i]);
 
-    try {
-        interpreter->executeFuncBlock(env, declaration->body);
-    } catch (Return &value) {
-        return value.value;
-    }
-    return nullptr;
+    return interpreter->executeFuncBlock(*env, declaration->body, constants);
+}
+
+auto FlatFunction::call(Interpreter *interpreter, Token &,
+                        std::span<Types::Value> arguments) -> Types::Value {
+    Env env(new Environment());
+
+    auto &node = (*tree)[declaration];
+    for (size_t i{}; i < node.a; ++i)
+        env->defineAt(i, arguments[i]);
+
+    return interpreter->executeFuncBlock(*env, tree, node.b);
 }
 
-auto PowCallable::call(Interpreter* interpreter, Token& token, std::vector<Types::Literal> arguments) -> Types::Literal
+auto PowCallable::call(Interpreter* interpreter, Token& token, std::span<Types::Value> arguments) -> Types::Value
 {
-    auto num = std::get_if<Types::Number>(&arguments[0]);
-    auto power = std::get_if<Types::Number>(&arguments[1]);
+    auto& num = arguments[0];
+    auto& power = arguments[1];
 
-    if (!num and !power) throw RuntimeError(token, "args should be numbers");
+    if (!num.isNumber() or !power.isNumber()) throw RuntimeError(token, "args should be numbers");
 
-    return std::visit([] (auto base, auto exp) {
-            return std::pow(base, exp);
-    }, *num, *power);
+    return std::pow(num.toDouble(), power.toDouble());
 }
 
-auto ClockCallable::call(Interpreter* interpreter, Types::Token& token, std::vector<Types::Literal> arguments) -> Types::Literal
+auto ClockCallable::call(Interpreter* interpreter, Types::Token& token, std::span<Types::Value> arguments) -> Types::Value
 {
     return (int) time(NULL);
 }
 
-auto Log2Callable::call(Interpreter* interpreter, Types::Token& token, std::vector<Types::Literal> arguments) -> Types::Literal 
+auto Log2Callable::call(Interpreter* interpreter, Types::Token& token, std::span<Types::Value> arguments) -> Types::Value 
 {
-    auto num = std::get_if<Types::Number>(&arguments[0]);
+    auto& num = arguments[0];
 
-    if (!num) throw RuntimeError(token, "argument is required to be a number");
+    if (!num.isNumber()) throw RuntimeError(token, "argument is required to be a number");
 
-    return std::visit([] (auto value) {
-            return std::log2(value);
-    }, *num);
+    return std::log2(num.toDouble());
 }
 
-auto PRNCallable::call(Interpreter* interpreter, Types::Token& token, std::vector<Types::Literal> arguments) -> Types::Literal 
+auto PRNCallable::call(Interpreter* interpreter, Types::Token& token, std::span<Types::Value> arguments) -> Types::Value 
 {
-    auto expr = std::get_if<std::string>(&arguments[0]);
+    auto& expr = arguments[0];
 
-    if (!expr) throw RuntimeError(token, "argument is required to be a string");
+    if (!expr.isString()) throw RuntimeError(token, "argument is required to be a string");
 
-    return polish_notation(*expr);
+    return polish_notation(expr.asString());
 }
 
-auto TypeCallable::call(Interpreter* interpreter, Types::Token& token, std::vector<Types::Literal> arguments) -> Types::Literal 
+auto TypeCallable::call(Interpreter* interpreter, Types::Token& token, std::span<Types::Value> arguments) -> Types::Value 
 {
-    return std::visit(Types::Typify(), arguments[0]);
+    return Types::visit(Types::Typify(), arguments[0]);
 }
 
 auto polish_notation(const std::string& expr) -> std::string {
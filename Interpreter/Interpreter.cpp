@@ -2,7 +2,7 @@
 #include <iostream>
 #include <memory>
 #include <string>
-#include <variant>
+#include <utility>
 
 #include "Interpreter.h"
 #include "../tools/colors.h"
@@ -20,59 +20,54 @@ static void runtimeError(RuntimeError &error) {
 }
 
 
-// Service function
-auto Interpreter::convert_to_one_type(std::vector<Types::Number*> nums)
-    -> void {
-
-    if (nums.size() == 0) return;
-    auto max_index = nums[0]->index();
-    for (auto num : nums)
-        if (max_index < num->index())
-            max_index = num->index();
-
-    for (auto& num : nums)
-        switch (max_index){
-            case 1:
-                std::visit([&num](auto value) { *num = (int)value; }, *num);
-                break;
-            case 2:
-                std::visit([&num](auto value) { *num = (double)value; }, *num);
-                break;
-            default: break;
-        }
-}
-auto Interpreter::evaluate(Expr *expr) -> Lit { return expr->accept(this); }
-auto Interpreter::executeFuncBlock(Env env, std::vector<Stmt *> &statements)
-    -> void {
+auto Interpreter::evaluate(Expr *expr) -> Lit { return dispatchExpr(expr); }
+auto Interpreter::executeFuncBlock(Environment &env, std::vector<Stmt *> &statements,
+                                   const Types::Constants *pool) -> Lit {
+    // the function may come from an earlier program with its own literals;
+    // they are put back however the call ends, a runtime error included
+    auto saved_constants = std::exchange(constants, pool);
+    auto restore = [&saved_constants](auto *pool) { *pool = saved_constants; };
+    std::unique_ptr<const Types::Constants *, decltype(restore)> pool_backup(&constants, restore);
     auto saved_env = environment;
-    auto back = [&saved_env](Env *env) { std::swap(*env, saved_env); };
-    std::unique_ptr<Env, decltype(back)> backup(&environment, back);
+    auto back = [&saved_env](Environment **env) { *env = saved_env; };
+    std::unique_ptr<Environment *, decltype(back)> backup(&environment, back);
 
-    environment = env;
+    environment = &env;
     environment->enclosing = globals.get();
     for (auto stmt : statements)
-        execute(stmt);
+        if (!execute(stmt))
+            break;
+
+    if (!returning)
+        return nullptr;
+    returning = false;
+    return std::move(return_value);
 }
-auto Interpreter::executeBlock(Env env, std::vector<Stmt *> &statements)
+auto Interpreter::executeBlock(Environment &env, std::vector<Stmt *> &statements)
     -> void {
     auto saved_env = environment;
-    auto back = [&saved_env](Env *env) { std::swap(*env, saved_env); };
-    std::unique_ptr<Env, decltype(back)> backup(&environment, back);
+    auto back = [&saved_env](Environment **env) { *env = saved_env; };
+    std::unique_ptr<Environment *, decltype(back)> backup(&environment, back);
 
-    environment = env;
-    environment->enclosing = saved_env.get();
+    environment = &env;
+    environment->enclosing = saved_env;
     for (auto stmt : statements)
-        execute(stmt);
+        if (!execute(stmt))
+            break;
+}
+// returns false when the statement completed with a return
+auto Interpreter::execute(Stmt *stmt) -> bool {
+    dispatchStmt(stmt);
+    return !returning;
 }
-auto Interpreter::execute(Stmt *stmt) -> void { stmt->accept(this); }
-auto Interpreter::isTruthy(Lit obj) -> bool {
-    if (Types::isNil(obj))
+auto Interpreter::isTruthy(const Lit &obj) -> bool {
+    if (obj.isNil())
         return false;
-    if (std::holds_alternative<bool>(obj))
-        return std::get<bool>(obj);
+    if (obj.isBool())
+        return obj.asBool();
     return true;
 }
-auto Interpreter::isEqual(Lit lhs, Lit rhs) -> bool {
+auto Interpreter::isEqual(const Lit &lhs, const Lit &rhs) -> bool {
     // if (Types::isNil(lhs) and Types::isNil(rhs))
     //     return true;
     // if (!Types::isNil(lhs))
@@ -81,11 +76,15 @@ auto Interpreter::isEqual(Lit lhs, Lit rhs) -> bool {
     return lhs == rhs;
 }
 auto Interpreter::stringify(const Lit &value) -> std::string {
-    return std::visit(Types::Stringify(), value);
+    return Types::visit(Types::Stringify(), value);
 }
-auto Interpreter::operation(Types::Token op, double lhs, double rhs) -> Lit {
+auto Interpreter::operation(const Types::Token &op, double lhs, double rhs) -> Lit {
     using namespace Types;
     switch (op.type()) {
+    case EQUAL_EQUAL:
+        return lhs == rhs;
+    case BANG_EQUAL:
+        return lhs != rhs;
     case MINUS:
         return lhs - rhs;
     case SLASH:
@@ -103,13 +102,17 @@ auto Interpreter::operation(Types::Token op, double lhs, double rhs) -> Lit {
     case LESS_EQUAL:
         return lhs <= rhs;
     default:
-        throw RuntimeError(op, "there is no operation '" + op.lexeme() +
+        throw RuntimeError(op, "there is no operation '" + std::string(op.lexeme()) +
                                    "' for doubles");
     }
 }
-auto Interpreter::operation(Types::Token op, int lhs, int rhs) -> Lit {
+auto Interpreter::operation(const Types::Token &op, int lhs, int rhs) -> Lit {
     using namespace Types;
     switch (op.type()) {
+    case EQUAL_EQUAL:
+        return lhs == rhs;
+    case BANG_EQUAL:
+        return lhs != rhs;
     case MINUS:
         return lhs - rhs;
     case SLASH:
@@ -131,11 +134,13 @@ auto Interpreter::operation(Types::Token op, int lhs, int rhs) -> Lit {
     case SHIFT_RIGHT:
         return lhs >> rhs;
     default:
-        throw RuntimeError(op, "there is no operation '" + op.lexeme() +
+        throw RuntimeError(op, "there is no operation '" + std::string(op.lexeme()) +
                                    "' for integers");
     }
 }
-auto Interpreter::interprete(std::vector<Stmt *> statements) -> void {
+auto Interpreter::interprete(std::vector<Stmt *> statements,
+                             const Types::Constants &pool) -> void {
+    constants = &pool;
     try {
 
         for (auto &statement : statements)
@@ -143,6 +148,7 @@ auto Interpreter::interprete(std::vector<Stmt *> statements) -> void {
 
     } catch (RuntimeError &err) {
         runtimeError(err);
+        returning = false;
     }
 }
 
@@ -158,14 +164,24 @@ auto Interpreter::visit(VarStmt *stmt) -> void {
     if (stmt->init != nullptr)
         value = evaluate(stmt->init);
 
-    environment->define(stmt->name.lexeme(), value);
+    if (stmt->slot == -1)
+        environment->define(stmt->name.symbol(), value);
+    else
+        environment->defineAt(stmt->slot, value);
 }
 auto Interpreter::visit(BlockStmt *stmt) -> void {
-    executeBlock(Env(new Environment()), stmt->statements);
+    if (stmt->frame == -1 or stmt->frame > Frame::SIZE) {
+        Env env(new Environment());
+        executeBlock(*env, stmt->statements);
+        return;
+    }
+    Frame frame;
+    executeBlock(frame.env(), stmt->statements);
 }
 auto Interpreter::visit(WhileStmt *stmt) -> void {
     while (isTruthy(evaluate(stmt->condition)))
-        execute(stmt->body);
+        if (!execute(stmt->body))
+            break;
 }
 auto Interpreter::visit(IfStmt *stmt) -> void {
     if (isTruthy(evaluate(stmt->condition)))
@@ -175,66 +191,66 @@ auto Interpreter::visit(IfStmt *stmt) -> void {
 }
 auto Interpreter::visit(FunctionStmt *stmt) -> void {
     // Function* function = new Function(stmt, new Environment(*environment));
-    Function *function = new Function(stmt);
-    environment->define(stmt->name.lexeme(), function);
+    Function *function = new Function(stmt, constants);
+    if (stmt->slot == -1)
+        environment->define(stmt->name.symbol(), function);
+    else
+        environment->defineAt(stmt->slot, function);
 }
 auto Interpreter::visit(ReturnStmt *stmt) -> void {
     Lit value = nullptr;
     if (stmt->expr)
         value = evaluate(stmt->expr);
 
-    throw Return(value);
+    return_value = std::move(value);
+    returning = true;
 }
 
 
 // Expressions
-auto Interpreter::visit(LiteralExpr *expr) -> Lit { return expr->value; }
+auto Interpreter::visit(LiteralExpr *expr) -> Lit {
+    return (*constants)[expr->constant];
+}
 auto Interpreter::visit(BinaryExpr *expr) -> Lit {
-    using namespace Types;
     Lit left = evaluate(expr->left);
     Lit right = evaluate(expr->right);
 
-    if (expr->op.type() == BANG_EQUAL)
+    // operands proven by TypeInference skip the kind checks and promotion
+    switch (expr->operands) {
+    case Value::INT:
+        return operation(expr->op, left.asInt(), right.asInt());
+    case Value::DOUBLE:
+        return operation(expr->op, left.asDouble(), right.asDouble());
+    default:
+        return binary(expr->op, std::move(left), std::move(right));
+    }
+}
+auto Interpreter::binary(const Types::Token &op, Lit left, Lit right) -> Lit {
+    using namespace Types;
+    if (op.type() == BANG_EQUAL)
         return !isEqual(left, right);
-    if (expr->op.type() == EQUAL_EQUAL)
+    if (op.type() == EQUAL_EQUAL)
         return isEqual(left, right);
 
-    Number *lhsNum = std::get_if<Number>(&left);
-    Number *rhsNum = std::get_if<Number>(&right);
-
-    // convert all to double if there're different
-    if (lhsNum and rhsNum) {
-        convert_to_one_type({lhsNum, rhsNum});
-        {
-            auto lhs = std::get_if<uint8_t>(lhsNum);
-            auto rhs = std::get_if<uint8_t>(rhsNum);
-            if (lhs and rhs)
-                return operation(expr->op, *lhs, *rhs);
-        }
-        {
-            auto lhs = std::get_if<int>(lhsNum);
-            auto rhs = std::get_if<int>(rhsNum);
-            if (lhs and rhs)
-                return operation(expr->op, *lhs, *rhs);
-        }
-        {
-            auto lhs = std::get_if<double>(lhsNum);
-            auto rhs = std::get_if<double>(rhsNum);
-            if (lhs and rhs)
-                return operation(expr->op, *lhs, *rhs);
+    if (left.isNumber() and right.isNumber()) {
+        switch (Value::promote(left.kind(), right.kind())) {
+        case Value::BYTE:
+            return operation(op, left.asByte(), right.asByte());
+        case Value::INT:
+            return operation(op, left.toInt(), right.toInt());
+        default:
+            return operation(op, left.toDouble(), right.toDouble());
         }
     }
 
-    if (lhsNum and not rhsNum)
-        throw RuntimeError(expr->op, "Second operand should be number.");
+    if (left.isNumber())
+        throw RuntimeError(op, "Second operand should be number.");
 
     // operations with strings
-    auto lhs = std::get_if<std::string>(&left);
-
-    if (lhs == nullptr)
-        throw RuntimeError(expr->op, "First operand should be number or string.");
+    if (not left.isString())
+        throw RuntimeError(op, "First operand should be number or string.");
 
-    return *lhs + stringify(right);
+    return left.asString() + stringify(right);
 }
 auto Interpreter::visit(LogicalExpr *expr) -> Lit {
     Lit left = evaluate(expr->left);
@@ -256,28 +272,44 @@ auto Interpreter::visit(UnaryExpr *expr) -> Lit {
     using namespace Types;
     Lit right = evaluate(expr->right);
 
-    Number* num;
     switch (expr->op.type()) {
     case BANG:
         return !isTruthy(right);
     case MINUS:
-        num = std::get_if<Number>(&right);
-        if (!num) throw RuntimeError(expr->op, "Unary operand for '-' should be number");
-        std::visit([] (auto& value) { value = -value; }, *num);
-        return *num;
+        return negate(expr->op, std::move(right));
     default:
         return nullptr;
     }
 }
+auto Interpreter::negate(const Types::Token &op, Lit right) -> Lit {
+    switch (right.kind()) {
+    case Value::BYTE:
+        return (uint8_t)-right.asByte();
+    case Value::INT:
+        return -right.asInt();
+    case Value::DOUBLE:
+        return -right.asDouble();
+    default:
+        throw RuntimeError(op, "Unary operand for '-' should be number");
+    }
+}
 auto Interpreter::visit(VariableExpr *expr) -> Lit {
-    return environment->get(expr->name);
+    if (expr->depth != -1)
+        return environment->getAt(expr->depth, expr->slot);
+    return globals->get(expr->name);
 }
 auto Interpreter::visit(AssignExpr *expr) -> Lit {
     auto value = evaluate(expr->value);
-    environment->assign(expr->name, value);
+    if (expr->depth != -1)
+        environment->assignAt(expr->depth, expr->slot, value);
+    else
+        globals->assign(expr->name, value);
     return value;
 }
 auto Interpreter::visit(CallExpr *expr) -> Lit {
+    if (expr->inlined)
+        return evaluate(expr->inlined);
+
     auto callee = evaluate(expr->callee);
 
     std::vector<Lit> arguments;
@@ -285,10 +317,10 @@ auto Interpreter::visit(CallExpr *expr) -> Lit {
     for (auto &argument : expr->arguments)
         arguments.push_back(evaluate(argument));
 
-    if (!std::holds_alternative<Callable *>(callee))
+    if (!callee.isCallable())
         throw RuntimeError(expr->paren, "Can only call functions.");
 
-    auto function = std::get<Callable *>(callee);
+    auto function = callee.asCallable();
 
     if ((int)arguments.size() != function->arity())
         throw RuntimeError(expr->paren,
@@ -298,3 +330,227 @@ auto Interpreter::visit(CallExpr *expr) -> Lit {
 
     return function->call(this, expr->paren, arguments);
 }
+
+
+// Flat syntax tree
+auto Interpreter::interprete(const flat::Tree &code) -> void {
+    tree = &code;
+    constants = code.constants.get();
+    try {
+
+        for (auto statement : tree->list(tree->statements))
+            execute(statement);
+
+    } catch (RuntimeError &err) {
+        runtimeError(err);
+        returning = false;
+    }
+}
+auto Interpreter::executeFuncBlock(Environment &env, const flat::Tree *code,
+                                   flat::Index statements) -> Lit {
+    // the function may come from an earlier program with its own tree;
+    // it is put back however the call ends, a runtime error included
+    auto saved_tree = std::exchange(tree, code);
+    auto saved_constants = std::exchange(constants, code->constants.get());
+    auto restore = [&saved_tree, &saved_constants](Interpreter *interpreter) {
+        interpreter->tree = saved_tree;
+        interpreter->constants = saved_constants;
+    };
+    std::unique_ptr<Interpreter, decltype(restore)> code_backup(this, restore);
+    auto saved_env = environment;
+    auto back = [&saved_env](Environment **env) { *env = saved_env; };
+    std::unique_ptr<Environment *, decltype(back)> backup(&environment, back);
+
+    environment = &env;
+    environment->enclosing = globals.get();
+    for (auto stmt : tree->list(statements))
+        if (!execute(stmt))
+            break;
+
+    if (!returning)
+        return nullptr;
+    returning = false;
+    return std::move(return_value);
+}
+auto Interpreter::executeBlock(Environment &env, flat::Index statements) -> void {
+    auto saved_env = environment;
+    auto back = [&saved_env](Environment **env) { *env = saved_env; };
+    std::unique_ptr<Environment *, decltype(back)> backup(&environment, back);
+
+    environment = &env;
+    environment->enclosing = saved_env;
+    for (auto stmt : tree->list(statements))
+        if (!execute(stmt))
+            break;
+}
+// returns false when the statement completed with a return
+auto Interpreter::execute(flat::Index index) -> bool {
+    using namespace flat;
+    auto &node = (*tree)[index];
+    switch (node.kind) {
+    case EXPRESSION:
+        evaluate(node.a);
+        break;
+
+    case PRINT: {
+        auto value = evaluate(node.a);
+        std::cout << WHITE << stringify(value) << std::endl;
+        break;
+    }
+
+    case VAR: {
+        Lit value = nullptr;
+        if (node.a != NONE)
+            value = evaluate(node.a);
+
+        if ((int)node.b == -1)
+            environment->define(tree->tokens[node.token].symbol, value);
+        else
+            environment->defineAt(node.b, value);
+        break;
+    }
+
+    case BLOCK:
+        if (node.b == NONE or node.b > Frame::SIZE) {
+            Env env(new Environment());
+            executeBlock(*env, node.a);
+        } else {
+            Frame frame;
+            executeBlock(frame.env(), node.a);
+        }
+        break;
+
+    case WHILE:
+        while (isTruthy(evaluate(node.a)))
+            if (!execute(node.b))
+                break;
+        break;
+
+    case IF:
+        if (isTruthy(evaluate(node.a)))
+            execute(node.b);
+        else if (node.c != NONE)
+            execute(node.c);
+        break;
+
+    case FUNCTION: {
+        FlatFunction *function = new FlatFunction(tree, index);
+        if ((int)node.c == -1)
+            environment->define(tree->tokens[node.token].symbol, function);
+        else
+            environment->defineAt(node.c, function);
+        break;
+    }
+
+    case RETURN: {
+        Lit value = nullptr;
+        if (node.a != NONE)
+            value = evaluate(node.a);
+
+        return_value = std::move(value);
+        returning = true;
+        break;
+    }
+
+    default:
+        evaluate(index);
+    }
+    return !returning;
+}
+auto Interpreter::evaluate(flat::Index index) -> Lit {
+    using namespace flat;
+    auto &node = (*tree)[index];
+    switch (node.kind) {
+    case LITERAL:
+        return (*constants)[node.a];
+
+    case BINARY: {
+        Lit left = evaluate(node.a);
+        Lit right = evaluate(node.b);
+
+        switch (node.c) {
+        case Value::INT:
+            return operation(tree->token(node.token), left.asInt(), right.asInt());
+        case Value::DOUBLE:
+            return operation(tree->token(node.token), left.asDouble(), right.asDouble());
+        default:
+            return binary(tree->token(node.token), std::move(left), std::move(right));
+        }
+    }
+
+    case LOGICAL: {
+        Lit left = evaluate(node.a);
+
+        if (tree->tokens[node.token].type == Types::OR) {
+            if (isTruthy(left))
+                return left;
+        } else {
+            if (!isTruthy(left))
+                return left;
+        }
+
+        return evaluate(node.b);
+    }
+
+    case GROUPING:
+        return evaluate(node.a);
+
+    case UNARY: {
+        Lit right = evaluate(node.a);
+
+        switch (tree->tokens[node.token].type) {
+        case Types::BANG:
+            return !isTruthy(right);
+        case Types::MINUS:
+            return negate(tree->token(node.token), std::move(right));
+        default:
+            return nullptr;
+        }
+    }
+
+    case VARIABLE: {
+        if ((int)node.a != -1)
+            return environment->getAt(node.a, node.b);
+        auto name = tree->token(node.token);
+        return globals->get(name);
+    }
+
+    case ASSIGN: {
+        auto value = evaluate(node.a);
+        if ((int)node.b != -1)
+            environment->assignAt(node.b, node.c, value);
+        else
+            globals->assign(tree->token(node.token), value);
+        return value;
+    }
+
+    case CALL: {
+        if (node.c != NONE)
+            return evaluate(node.c);
+
+        auto callee = evaluate(node.a);
+
+        std::vector<Lit> arguments;
+
+        for (auto argument : tree->list(node.b))
+            arguments.push_back(evaluate(argument));
+
+        auto paren = tree->token(node.token);
+        if (!callee.isCallable())
+            throw RuntimeError(paren, "Can only call functions.");
+
+        auto function = callee.asCallable();
+
+        if ((int)arguments.size() != function->arity())
+            throw RuntimeError(paren,
+                               "Expect " + std::to_string(function->arity()) +
+                                   " arguments but got " +
+                                   std::to_string(arguments.size()) + ".");
+
+        return function->call(this, paren, arguments);
+    }
+
+    default:
+        return nullptr;
+    }
+}
@@ -3,28 +3,24 @@
 #include <ios>
 #include <iostream>
 #include <memory>
+#include <span>
 #include <stdexcept>
-#include <variant>
 #include <vector>
 
 #include "../Environment/Environment.h"
 #include "../Parser/Expr.h"
+#include "../Parser/FlatAst.h"
 #include "../Parser/Stmt.h"
+#include "../Types/Constants.h"
 #include "../Types/Token.h"
 
 namespace lox {
 
-class Return : public std::runtime_error {
-  public:
-    Types::Literal value;
-    Return(Types::Literal value) : std::runtime_error(""), value(value) {}
-};
-
 class ClockCallable : public Types::Callable {
   public:
     auto arity() -> int override { return 0; }
     auto call(Interpreter *interpreter, Types::Token &token,
-              std::vector<Types::Literal> arguments) -> Types::Literal override;
+              std::span<Types::Value> arguments) -> Types::Value override;
     auto toString() -> std::string override { return "<fun native>"; }
 };
 
@@ -32,7 +28,7 @@ class PowCallable : public Types::Callable {
   public:
     auto arity() -> int override { return 2; }
     auto call(Interpreter *interpreter, Types::Token &token,
-              std::vector<Types::Literal> arguments) -> Types::Literal override;
+              std::span<Types::Value> arguments) -> Types::Value override;
     auto toString() -> std::string override { return "<fun native>"; }
 };
 
@@ -40,7 +36,7 @@ class Log2Callable : public Types::Callable {
   public:
     auto arity() -> int override { return 1; }
     auto call(Interpreter *interpreter, Types::Token &token,
-              std::vector<Types::Literal> arguments) -> Types::Literal override;
+              std::span<Types::Value> arguments) -> Types::Value override;
     auto toString() -> std::string override { return "<fun native>"; }
 };
 
@@ -48,7 +44,7 @@ class PRNCallable : public Types::Callable {
   public:
     auto arity() -> int override { return 1; }
     auto call(Interpreter *interpreter, Types::Token &token,
-              std::vector<Types::Literal> arguments) -> Types::Literal override;
+              std::span<Types::Value> arguments) -> Types::Value override;
     auto toString() -> std::string override { return "<fun native>"; }
 };
 
@@ -56,49 +52,83 @@ class TypeCallable : public Types::Callable {
   public:
     auto arity() -> int override { return 1; }
     auto call(Interpreter *interpreter, Types::Token &token,
-              std::vector<Types::Literal> arguments) -> Types::Literal override;
+              std::span<Types::Value> arguments) -> Types::Value override;
     auto toString() -> std::string override { return "<fun native>"; }
 };
 
 class Function : public Types::Callable {
   private:
     FunctionStmt *declaration;
+    // literals of the program the function was declared in
+    const Types::Constants *constants = nullptr;
     // Env closure;
   public:
     // Function(FunctionStmt* declaration, Environment* closure):
     //     declaration(declaration), closure(closure)
     //{}
 
-    Function(FunctionStmt *declaration) : declaration(declaration) {}
+    Function(FunctionStmt *declaration,
+             const Types::Constants *constants = nullptr)
+        : declaration(declaration), constants(constants) {}
 
     auto arity() -> int override { return declaration->params.size(); }
     auto toString() -> std::string override {
-        return "<fun " + declaration->name.lexeme() + ">";
+        return "<fun " + std::string(declaration->name.lexeme()) + ">";
+    }
+
+    auto call(Interpreter *interpreter, Types::Token &token,
+              std::span<Types::Value> arguments) -> Types::Value override;
+};
+
+// Function declared in a flat syntax tree, which has to outlive it.
+class FlatFunction : public Types::Callable {
+  private:
+    const flat::Tree *tree;
+    flat::Index declaration;
+
+  public:
+    FlatFunction(const flat::Tree *tree, flat::Index declaration)
+        : tree(tree), declaration(declaration) {}
+
+    auto arity() -> int override { return (*tree)[declaration].a; }
+    auto toString() -> std::string override {
+        auto name = tree->token((*tree)[declaration].token).lexeme();
+        return "<fun " + std::string(name) + ">";
     }
 
     auto call(Interpreter *interpreter, Types::Token &token,
-              std::vector<Types::Literal> arguments) -> Types::Literal override;
+              std::span<Types::Value> arguments) -> Types::Value override;
 };
 
 class RuntimeError;
 
-class Interpreter : public ExprVisitor, public StmtVisitor {
+class Interpreter : public ExprStaticVisitor<Interpreter>, public StmtStaticVisitor<Interpreter> {
   public:
     typedef Types::Literal Lit;
     Env globals = std::make_shared<Environment>();
 
   private:
-    Env environment = globals;
+    // innermost scope of the code being executed; the callers of
+    // executeBlock() and executeFuncBlock() own it
+    Environment *environment = globals.get();
+    // literals of the code being executed
+    const Types::Constants *constants = nullptr;
+    // flat tree of the code being executed, when it was given in that form
+    const flat::Tree *tree = nullptr;
+
+    // How the last executed statement completed. A return statement sets
+    // returning and every statement list stops early until the enclosing
+    // function call picks up return_value.
+    bool returning = false;
+    Lit return_value;
 
     auto evaluate(Expr *expr) -> Lit;
-    auto isTruthy(Lit obj) -> bool;
-    auto isEqual(Lit lhs, Lit rhs) -> bool;
-    auto execute(Stmt *stmt) -> void;
-    auto stringify(const Lit &lit) -> std::string;
-    auto convert_to_one_type(std::vector<Types::Number*> nums) -> void;
-
-    auto operation(Types::Token op, int lhs, int rhs) -> Lit;
-    auto operation(Types::Token op, double lhs, double rhs) -> Lit;
+    auto execute(Stmt *stmt) -> bool;
+    auto evaluate(flat::Index node) -> Lit;
+    auto execute(flat::Index node) -> bool;
+    auto executeBlock(Environment &env, flat::Index statements) -> void;
+    static auto operation(const Types::Token &op, int lhs, int rhs) -> Lit;
+    static auto operation(const Types::Token &op, double lhs, double rhs) -> Lit;
 
   public:
     Interpreter() {
@@ -109,29 +139,41 @@ class Interpreter : public ExprVisitor, public StmtVisitor {
         globals->define("type", new TypeCallable());
     }
 
-    auto interprete(std::vector<Stmt *> stmts) -> void;
-    auto executeBlock(Env env, std::vector<Stmt *> &statements) -> void;
-    auto executeFuncBlock(Env env, std::vector<Stmt *> &statements) -> void;
+    auto interprete(std::vector<Stmt *> stmts, const Types::Constants &pool)
+        -> void;
+    auto interprete(const flat::Tree &tree) -> void;
+
+    // Value semantics shared with the bytecode VM
+    static auto binary(const Types::Token &op, Lit left, Lit right) -> Lit;
+    static auto negate(const Types::Token &op, Lit right) -> Lit;
+    static auto isTruthy(const Lit &obj) -> bool;
+    static auto isEqual(const Lit &lhs, const Lit &rhs) -> bool;
+    static auto stringify(const Lit &lit) -> std::string;
+    auto executeBlock(Environment &env, std::vector<Stmt *> &statements) -> void;
+    auto executeFuncBlock(Environment &env, std::vector<Stmt *> &statements,
+                          const Types::Constants *pool) -> Lit;
+    auto executeFuncBlock(Environment &env, const flat::Tree *code,
+                          flat::Index statements) -> Lit;
 
     // Expressions
-    auto visit(BinaryExpr *expr) -> Lit override;
-    auto visit(LogicalExpr *expr) -> Lit override;
-    auto visit(GroupingExpr *expr) -> Lit override;
-    auto visit(LiteralExpr *expr) -> Lit override;
-    auto visit(UnaryExpr *expr) -> Lit override;
-    auto visit(VariableExpr *expr) -> Lit override;
-    auto visit(AssignExpr *expr) -> Lit override;
-    auto visit(CallExpr *expr) -> Lit override;
+    auto visit(BinaryExpr *expr) -> Lit;
+    auto visit(LogicalExpr *expr) -> Lit;
+    auto visit(GroupingExpr *expr) -> Lit;
+    auto visit(LiteralExpr *expr) -> Lit;
+    auto visit(UnaryExpr *expr) -> Lit;
+    auto visit(VariableExpr *expr) -> Lit;
+    auto visit(AssignExpr *expr) -> Lit;
+    auto visit(CallExpr *expr) -> Lit;
 
     // Statements
-    auto visit(ExpressionStmt *stmt) -> void override;
-    auto visit(PrintStmt *stmt) -> void override;
-    auto visit(VarStmt *stmt) -> void override;
-    auto visit(BlockStmt *stmt) -> void override;
-    auto visit(WhileStmt *stmt) -> void override;
-    auto visit(IfStmt *stmt) -> void override;
-    auto visit(FunctionStmt *stmt) -> void override;
-    auto visit(ReturnStmt *stmt) -> void override;
+    auto visit(ExpressionStmt *stmt) -> void;
+    auto visit(PrintStmt *stmt) -> void;
+    auto visit(VarStmt *stmt) -> void;
+    auto visit(BlockStmt *stmt) -> void;
+    auto visit(WhileStmt *stmt) -> void;
+    auto visit(IfStmt *stmt) -> void;
+    auto visit(FunctionStmt *stmt) -> void;
+    auto visit(ReturnStmt *stmt) -> void;
 
 }; // class Interpreter
 
@@ -0,0 +1,257 @@
+#include <algorithm>
+#include <utility>
+
+#include "DeadCode.h"
+
+namespace lox {
+
+auto DeadCode::eliminate(std::vector<Stmt *> &statements) -> void {
+    size_t before;
+    do {
+        before = removals.size();
+        global_uses.clear();
+        local_uses.clear();
+        count(statements);
+        sweep(statements);
+    } while (removals.size() != before);
+}
+
+auto DeadCode::report(std::ostream &out) -> void {
+    std::stable_sort(removals.begin(), removals.end(),
+            [](auto &lhs, auto &rhs) { return lhs.line < rhs.line; });
+    for (auto &removal : removals)
+        out << "[line " << removal.line << "] removed " << removal.what << "\n";
+    out << removals.size() << " removed by dead code elimination" << std::endl;
+}
+
+// Counting
+
+auto DeadCode::count(Expr *expr) -> void {
+    if (expr)
+        dispatchExpr(expr);
+}
+
+auto DeadCode::count(Stmt *stmt) -> void {
+    if (stmt)
+        dispatchStmt(stmt);
+}
+
+auto DeadCode::count(std::vector<Stmt *> &statements) -> void {
+    for (auto statement : statements)
+        count(statement);
+}
+
+auto DeadCode::use(const Types::Token &name, int depth, int slot) -> void {
+    if (depth == -1) {
+        if (name.symbol() != self)
+            ++global_uses[name.symbol()];
+        return;
+    }
+    if ((size_t)depth >= scopes.size())
+        return;
+    auto &slots = scopes[scopes.size() - 1 - depth];
+    if ((size_t)slot < slots.size() and slots[slot])
+        ++local_uses[slots[slot]];
+}
+
+auto DeadCode::declare(int slot, Stmt *declaration) -> void {
+    if (slot == -1 or scopes.empty())
+        return;
+    auto &slots = scopes.back();
+    if ((size_t)slot >= slots.size())
+        slots.resize(slot + 1);
+    slots[slot] = declaration;
+}
+
+// Expressions
+auto DeadCode::visit(BinaryExpr *expr) -> Lit {
+    count(expr->left);
+    count(expr->right);
+    return nullptr;
+}
+
+auto DeadCode::visit(LogicalExpr *expr) -> Lit {
+    count(expr->left);
+    count(expr->right);
+    return nullptr;
+}
+
+auto DeadCode::visit(GroupingExpr *expr) -> Lit {
+    count(expr->expr);
+    return nullptr;
+}
+
+auto DeadCode::visit(LiteralExpr *) -> Lit {
+    return nullptr;
+}
+
+auto DeadCode::visit(UnaryExpr *expr) -> Lit {
+    count(expr->right);
+    return nullptr;
+}
+
+auto DeadCode::visit(VariableExpr *expr) -> Lit {
+    use(expr->name, expr->depth, expr->slot);
+    return nullptr;
+}
+
+auto DeadCode::visit(AssignExpr *expr) -> Lit {
+    // a variable that is only written still has to exist
+    use(expr->name, expr->depth, expr->slot);
+    count(expr->value);
+    return nullptr;
+}
+
+auto DeadCode::visit(CallExpr *expr) -> Lit {
+    // the callee of an inlined call is not needed any more
+    if (expr->inlined) {
+        count(expr->inlined);
+        return nullptr;
+    }
+
+    count(expr->callee);
+    for (auto argument : expr->arguments)
+        count(argument);
+    return nullptr;
+}
+
+// Statements
+auto DeadCode::visit(ExpressionStmt *stmt) -> void {
+    count(stmt->expr);
+}
+
+auto DeadCode::visit(PrintStmt *stmt) -> void {
+    count(stmt->expr);
+}
+
+auto DeadCode::visit(VarStmt *stmt) -> void {
+    count(stmt->init);
+    declare(stmt->slot, stmt);
+}
+
+auto DeadCode::visit(BlockStmt *stmt) -> void {
+    scopes.emplace_back();
+    count(stmt->statements);
+    scopes.pop_back();
+}
+
+auto DeadCode::visit(WhileStmt *stmt) -> void {
+    count(stmt->condition);
+    count(stmt->body);
+}
+
+auto DeadCode::visit(IfStmt *stmt) -> void {
+    count(stmt->condition);
+    count(stmt->thenBranch);
+    count(stmt->elseBranch);
+}
+
+auto DeadCode::visit(FunctionStmt *stmt) -> void {
+    declare(stmt->slot, stmt);
+
+    // the body sees its parameters and the globals only
+    auto outer = std::exchange(scopes, {std::vector<Stmt *>(stmt->params.size())});
+    int outer_self = std::exchange(self, stmt->slot == -1 ? stmt->name.symbol() : -1);
+    count(stmt->body);
+    scopes = std::move(outer);
+    self = outer_self;
+}
+
+auto DeadCode::visit(ReturnStmt *stmt) -> void {
+    count(stmt->expr);
+}
+
+// Sweeping
+
+auto DeadCode::sweep(std::vector<Stmt *> &statements) -> void {
+    size_t kept = 0;
+    // line of the return that ends the list
+    int ended = 0;
+    int unreachable = 0;
+    for (auto statement : statements) {
+        if (ended) {
+            ++unreachable;
+            continue;
+        }
+        if (auto rest = sweep(statement)) {
+            statements[kept++] = rest;
+            if (functions)
+                ended = terminates(rest);
+        }
+    }
+    statements.resize(kept);
+
+    if (unreachable)
+        removals.push_back({ended, std::to_string(unreachable) +
+                                   " unreachable statement(s) after return"});
+}
+
+auto DeadCode::sweep(Stmt *stmt) -> Stmt * {
+    switch (stmt->kind) {
+    case StmtKind::VAR: {
+        auto var = static_cast<VarStmt *>(stmt);
+        if (used(var, var->name, var->slot))
+            return stmt;
+        removals.push_back({var->name.line(),
+                            "unused variable '" + std::string(var->name.lexeme()) + "'"});
+        if (var->init and not effects.pure(var->init))
+            return ExpressionStmt::create(arena, var->init);
+        return nullptr;
+    }
+    case StmtKind::FUNCTION: {
+        auto function = static_cast<FunctionStmt *>(stmt);
+        if (not used(function, function->name, function->slot)) {
+            removals.push_back({function->name.line(),
+                                "unused function '" + std::string(function->name.lexeme()) + "'"});
+            return nullptr;
+        }
+        ++functions;
+        sweep(function->body);
+        --functions;
+        return stmt;
+    }
+    case StmtKind::BLOCK:
+        sweep(static_cast<BlockStmt *>(stmt)->statements);
+        return stmt;
+    case StmtKind::IF: {
+        // branches are never declarations, nothing of them goes
+        auto branch = static_cast<IfStmt *>(stmt);
+        sweep(branch->thenBranch);
+        if (branch->elseBranch)
+            sweep(branch->elseBranch);
+        return stmt;
+    }
+    case StmtKind::WHILE:
+        sweep(static_cast<WhileStmt *>(stmt)->body);
+        return stmt;
+    default:
+        return stmt;
+    }
+}
+
+auto DeadCode::used(Stmt *declaration, const Types::Token &name, int slot) -> bool {
+    if (slot != -1)
+        return local_uses.contains(declaration);
+    return not globals or global_uses.contains(name.symbol());
+}
+
+auto DeadCode::terminates(Stmt *stmt) -> int {
+    switch (stmt->kind) {
+    case StmtKind::RETURN:
+        return static_cast<ReturnStmt *>(stmt)->keyword.line();
+    case StmtKind::BLOCK: {
+        auto &statements = static_cast<BlockStmt *>(stmt)->statements;
+        return statements.empty() ? 0 : terminates(statements.back());
+    }
+    case StmtKind::IF: {
+        auto branch = static_cast<IfStmt *>(stmt);
+        if (not branch->elseBranch or not terminates(branch->elseBranch))
+            return 0;
+        return terminates(branch->thenBranch);
+    }
+    default:
+        return 0;
+    }
+}
+
+} // namespace lox
@@ -0,0 +1,96 @@
+#pragma once
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../Parser/Arena.h"
+#include "../Parser/Expr.h"
+#include "../Parser/Stmt.h"
+#include "Effects.h"
+
+namespace lox {
+
+// Removes code that can never run or whose result nobody reads (-O):
+//  - statements after a return in the same function body, or after an 'if'
+//    whose branches both return
+//  - variables that are never referenced; an initializer that may have an
+//    effect or fail stays behind as an expression statement
+//  - functions that are never referenced outside their own body
+//
+// Removing something may leave others unreferenced, so rounds are repeated
+// until nothing changes. Globals are only removed when the whole program is
+// known, not in the REPL where later lines may use them.
+class DeadCode : public ExprStaticVisitor<DeadCode>, public StmtStaticVisitor<DeadCode> {
+  public:
+    typedef Types::Literal Lit;
+
+    // one entry of --report-dce
+    struct Removal {
+        int line;
+        std::string what;
+    };
+
+  private:
+    Arena &arena;
+    bool globals;
+    const Effects &effects;
+
+    // references counted by the last round: globals by symbol, locals by
+    // the statement that declares them
+    std::unordered_map<int, int> global_uses;
+    std::unordered_map<Stmt *, int> local_uses;
+    // declarations of the locals, one list of slots per environment,
+    // innermost last; nullptr for parameters
+    std::vector<std::vector<Stmt *>> scopes;
+    // symbol of the global function whose body is counted, its recursive
+    // calls do not keep it alive
+    int self = -1;
+    // nesting of function bodies being swept, a return only ends those
+    int functions = 0;
+
+    std::vector<Removal> removals;
+
+    auto count(Expr *expr) -> void;
+    auto count(Stmt *stmt) -> void;
+    auto count(std::vector<Stmt *> &statements) -> void;
+    auto use(const Types::Token &name, int depth, int slot) -> void;
+    auto declare(int slot, Stmt *declaration) -> void;
+
+    auto sweep(std::vector<Stmt *> &statements) -> void;
+    // what is left of the statement, nullptr when nothing
+    auto sweep(Stmt *stmt) -> Stmt *;
+    auto used(Stmt *declaration, const Types::Token &name, int slot) -> bool;
+    // line of the return that always ends the statement, 0 if there is none
+    auto terminates(Stmt *stmt) -> int;
+
+  public:
+    DeadCode(Arena &arena, const Effects &effects, bool globals)
+        : arena(arena), globals(globals), effects(effects) {}
+
+    auto eliminate(std::vector<Stmt *> &statements) -> void;
+    // what eliminate() removed, in source order
+    auto report(std::ostream &out) -> void;
+
+    // Expressions
+    auto visit(BinaryExpr *expr) -> Lit;
+    auto visit(LogicalExpr *expr) -> Lit;
+    auto visit(GroupingExpr *expr) -> Lit;
+    auto visit(LiteralExpr *expr) -> Lit;
+    auto visit(UnaryExpr *expr) -> Lit;
+    auto visit(VariableExpr *expr) -> Lit;
+    auto visit(AssignExpr *expr) -> Lit;
+    auto visit(CallExpr *expr) -> Lit;
+
+    // Statements
+    auto visit(ExpressionStmt *stmt) -> void;
+    auto visit(PrintStmt *stmt) -> void;
+    auto visit(VarStmt *stmt) -> void;
+    auto visit(BlockStmt *stmt) -> void;
+    auto visit(WhileStmt *stmt) -> void;
+    auto visit(IfStmt *stmt) -> void;
+    auto visit(FunctionStmt *stmt) -> void;
+    auto visit(ReturnStmt *stmt) -> void;
+};
+
+} // namespace lox
@@ -0,0 +1,235 @@
+#include "Effects.h"
+#include "../Types/Symbols.h"
+
+namespace lox {
+
+using Types::Symbols;
+using Types::Value;
+
+namespace {
+
+// natives without effects; pow and log2 only fail on other arguments than
+// numbers, type never does
+const int POW = Symbols::intern("pow");
+const int LOG2 = Symbols::intern("log2");
+const int TYPE = Symbols::intern("type");
+
+// The left operand decides that a binary expression concatenates.
+auto stringy(Expr *expr, const Types::Constants &constants) -> bool {
+    switch (expr->kind) {
+    case ExprKind::LITERAL:
+        return constants[static_cast<LiteralExpr *>(expr)->constant].isString();
+    case ExprKind::GROUPING:
+        return stringy(static_cast<GroupingExpr *>(expr)->expr, constants);
+    case ExprKind::BINARY: {
+        auto binary = static_cast<BinaryExpr *>(expr);
+        auto op = binary->op.type();
+        return op != Types::EQUAL_EQUAL and op != Types::BANG_EQUAL
+               and stringy(binary->left, constants);
+    }
+    default:
+        return false;
+    }
+}
+
+} // namespace
+
+Effects::Effects(const Types::Constants &constants, std::vector<Stmt *> *program)
+    : constants(constants) {
+    if (not program)
+        return;
+    natives = true;
+    for (auto statement : *program)
+        for (auto symbol : {POW, LOG2, TYPE})
+            if (assigns(statement, symbol))
+                natives = false;
+}
+
+auto Effects::assigns(Expr *expr, int symbol) -> bool {
+    if (not expr)
+        return false;
+    switch (expr->kind) {
+    case ExprKind::BINARY: {
+        auto binary = static_cast<BinaryExpr *>(expr);
+        return assigns(binary->left, symbol) or assigns(binary->right, symbol);
+    }
+    case ExprKind::LOGICAL: {
+        auto logical = static_cast<LogicalExpr *>(expr);
+        return assigns(logical->left, symbol) or assigns(logical->right, symbol);
+    }
+    case ExprKind::GROUPING:
+        return assigns(static_cast<GroupingExpr *>(expr)->expr, symbol);
+    case ExprKind::UNARY:
+        return assigns(static_cast<UnaryExpr *>(expr)->right, symbol);
+    case ExprKind::ASSIGN: {
+        auto assign = static_cast<AssignExpr *>(expr);
+        return (assign->depth == -1 and assign->name.symbol() == symbol)
+               or assigns(assign->value, symbol);
+    }
+    case ExprKind::CALL: {
+        auto call = static_cast<CallExpr *>(expr);
+        if (assigns(call->callee, symbol))
+            return true;
+        for (auto argument : call->arguments)
+            if (assigns(argument, symbol))
+                return true;
+        return false;
+    }
+    default:
+        return false;
+    }
+}
+
+auto Effects::assigns(Stmt *stmt, int symbol) -> bool {
+    if (not stmt)
+        return false;
+    switch (stmt->kind) {
+    case StmtKind::EXPRESSION:
+        return assigns(static_cast<ExpressionStmt *>(stmt)->expr, symbol);
+    case StmtKind::PRINT:
+        return assigns(static_cast<PrintStmt *>(stmt)->expr, symbol);
+    case StmtKind::VAR:
+        return assigns(static_cast<VarStmt *>(stmt)->init, symbol);
+    case StmtKind::RETURN:
+        return assigns(static_cast<ReturnStmt *>(stmt)->expr, symbol);
+    case StmtKind::IF: {
+        auto branch = static_cast<IfStmt *>(stmt);
+        return assigns(branch->condition, symbol) or assigns(branch->thenBranch, symbol)
+               or assigns(branch->elseBranch, symbol);
+    }
+    case StmtKind::WHILE: {
+        auto loop = static_cast<WhileStmt *>(stmt);
+        return assigns(loop->condition, symbol) or assigns(loop->body, symbol);
+    }
+    case StmtKind::BLOCK:
+        for (auto statement : static_cast<BlockStmt *>(stmt)->statements)
+            if (assigns(statement, symbol))
+                return true;
+        return false;
+    case StmtKind::FUNCTION:
+        for (auto statement : static_cast<FunctionStmt *>(stmt)->body)
+            if (assigns(statement, symbol))
+                return true;
+        return false;
+    default:
+        return false;
+    }
+}
+
+auto Effects::pure(Expr *expr) const -> bool {
+    using namespace Types;
+    switch (expr->kind) {
+    case ExprKind::LITERAL:
+        return true;
+    case ExprKind::VARIABLE:
+        // a global may not be defined yet
+        return static_cast<VariableExpr *>(expr)->depth != -1;
+    case ExprKind::GROUPING:
+        return pure(static_cast<GroupingExpr *>(expr)->expr);
+    case ExprKind::LOGICAL: {
+        auto logical = static_cast<LogicalExpr *>(expr);
+        return pure(logical->left) and pure(logical->right);
+    }
+    case ExprKind::UNARY: {
+        auto unary = static_cast<UnaryExpr *>(expr);
+        if (not pure(unary->right))
+            return false;
+        return unary->op.type() == BANG or numeric(unary->right);
+    }
+    case ExprKind::BINARY: {
+        auto binary = static_cast<BinaryExpr *>(expr);
+        if (not pure(binary->left) or not pure(binary->right))
+            return false;
+        switch (binary->op.type()) {
+        case EQUAL_EQUAL:
+        case BANG_EQUAL:
+            return true;
+        default:
+            break;
+        }
+        // concatenation takes anything on the right
+        if (stringy(binary->left, constants))
+            return true;
+        switch (binary->op.type()) {
+        case SHIFT_LEFT:
+        case SHIFT_RIGHT:
+            return false;
+        case SLASH:
+            // integers trap on zero
+            return binary->operands == Value::DOUBLE;
+        default:
+            return binary->operands != Value::NIL
+                   or (numeric(binary->left) and numeric(binary->right));
+        }
+    }
+    case ExprKind::CALL:
+        return pureCall(static_cast<CallExpr *>(expr));
+    default:
+        return false;
+    }
+}
+
+auto Effects::pureCall(CallExpr *call) const -> bool {
+    if (call->inlined)
+        return pure(call->inlined);
+    if (not natives or call->callee->kind != ExprKind::VARIABLE)
+        return false;
+
+    auto callee = static_cast<VariableExpr *>(call->callee);
+    auto &arguments = call->arguments;
+    if (callee->depth != -1)
+        return false;
+    for (auto argument : arguments)
+        if (not pure(argument))
+            return false;
+
+    int symbol = callee->name.symbol();
+    if (symbol == POW)
+        return arguments.size() == 2 and numeric(arguments[0]) and numeric(arguments[1]);
+    if (symbol == LOG2)
+        return arguments.size() == 1 and numeric(arguments[0]);
+    return symbol == TYPE and arguments.size() == 1;
+}
+
+auto Effects::numeric(Expr *expr) const -> bool {
+    using namespace Types;
+    switch (expr->kind) {
+    case ExprKind::LITERAL:
+        return constants[static_cast<LiteralExpr *>(expr)->constant].isNumber();
+    case ExprKind::GROUPING:
+        return numeric(static_cast<GroupingExpr *>(expr)->expr);
+    case ExprKind::UNARY: {
+        auto unary = static_cast<UnaryExpr *>(expr);
+        return unary->op.type() == MINUS and numeric(unary->right);
+    }
+    case ExprKind::BINARY: {
+        auto binary = static_cast<BinaryExpr *>(expr);
+        switch (binary->op.type()) {
+        case PLUS:
+        case MINUS:
+        case STAR:
+        case SLASH:
+        case SHIFT_LEFT:
+        case SHIFT_RIGHT:
+            return binary->operands != Value::NIL
+                   or (numeric(binary->left) and numeric(binary->right));
+        default:
+            return false;
+        }
+    }
+    case ExprKind::CALL: {
+        auto call = static_cast<CallExpr *>(expr);
+        if (call->inlined)
+            return numeric(call->inlined);
+        if (not natives or call->callee->kind != ExprKind::VARIABLE)
+            return false;
+        auto callee = static_cast<VariableExpr *>(call->callee);
+        int symbol = callee->name.symbol();
+        return callee->depth == -1 and (symbol == POW or symbol == LOG2);
+    }
+    default:
+        return false;
+    }
+}
+
+} // namespace lox
@@ -0,0 +1,34 @@
+#pragma once
+#include <vector>
+
+#include "../Parser/Expr.h"
+#include "../Parser/Stmt.h"
+#include "../Types/Constants.h"
+
+namespace lox {
+
+// What evaluating an expression may do, as far as the passes that remove
+// or move code need to know.
+class Effects {
+    const Types::Constants &constants;
+    // whether pow, log2 and type are known to still be the natives
+    bool natives = false;
+
+    static auto assigns(Expr *expr, int symbol) -> bool;
+    static auto assigns(Stmt *stmt, int symbol) -> bool;
+    auto pureCall(CallExpr *call) const -> bool;
+
+  public:
+    // Calls of the natives only count as pure when the whole program is
+    // given and assigns none of their names; not in the REPL, where an
+    // earlier line may have.
+    Effects(const Types::Constants &constants, std::vector<Stmt *> *program);
+
+    // Evaluating the expression has no effect and cannot fail, so it can be
+    // dropped, or moved and evaluated once for many times.
+    auto pure(Expr *expr) const -> bool;
+    // The expression evaluates to a number whenever it does not fail.
+    auto numeric(Expr *expr) const -> bool;
+};
+
+} // namespace lox
@@ -0,0 +1,222 @@
+#include "Inliner.h"
+
+namespace lox {
+
+auto Inliner::inlineCalls(std::vector<Stmt *> &statements) -> void {
+    for (size_t i = 0; i < statements.size(); ++i) {
+        auto statement = statements[i];
+        if (statement->kind == StmtKind::VAR) {
+            auto var = static_cast<VarStmt *>(statement);
+            globals.try_emplace(var->name.symbol(), i);
+        }
+        if (statement->kind != StmtKind::FUNCTION)
+            continue;
+
+        auto function = static_cast<FunctionStmt *>(statement);
+        globals.try_emplace(function->name.symbol(), i);
+        if (function->lazy or function->body.size() != 1
+            or function->body[0]->kind != StmtKind::RETURN)
+            continue;
+
+        auto body = static_cast<ReturnStmt *>(function->body[0])->expr;
+        int nodes = body ? size(body) : -1;
+        if (nodes != -1 and nodes <= BUDGET)
+            candidates.try_emplace(function->name.symbol(), Candidate{function, body, i});
+    }
+
+    walk(statements);
+    for (auto symbol : assigned)
+        candidates.erase(symbol);
+
+    collecting = false;
+    walk(statements);
+}
+
+auto Inliner::walk(Expr *expr) -> void {
+    if (expr)
+        dispatchExpr(expr);
+}
+
+auto Inliner::walk(Stmt *stmt) -> void {
+    if (stmt)
+        dispatchStmt(stmt);
+}
+
+auto Inliner::walk(std::vector<Stmt *> &statements) -> void {
+    for (current = 0; current < statements.size(); ++current)
+        walk(statements[current]);
+}
+
+auto Inliner::size(Expr *expr) -> int {
+    auto add = [](int lhs, int rhs) { return lhs == -1 or rhs == -1 ? -1 : lhs + rhs; };
+    switch (expr->kind) {
+    case ExprKind::LITERAL:
+    case ExprKind::VARIABLE:
+        return 1;
+    case ExprKind::GROUPING:
+        return add(1, size(static_cast<GroupingExpr *>(expr)->expr));
+    case ExprKind::UNARY:
+        return add(1, size(static_cast<UnaryExpr *>(expr)->right));
+    case ExprKind::BINARY: {
+        auto binary = static_cast<BinaryExpr *>(expr);
+        return add(1, add(size(binary->left), size(binary->right)));
+    }
+    case ExprKind::LOGICAL: {
+        auto logical = static_cast<LogicalExpr *>(expr);
+        return add(1, add(size(logical->left), size(logical->right)));
+    }
+    default:
+        return -1;
+    }
+}
+
+auto Inliner::atomic(Expr *argument) -> bool {
+    if (argument->kind == ExprKind::LITERAL)
+        return true;
+    if (argument->kind != ExprKind::VARIABLE)
+        return false;
+
+    auto variable = static_cast<VariableExpr *>(argument);
+    if (variable->depth != -1)
+        return true;
+    auto global = globals.find(variable->name.symbol());
+    return global != globals.end() and global->second < current;
+}
+
+auto Inliner::substitute(Expr *expr, std::span<Expr *> arguments) -> Expr * {
+    switch (expr->kind) {
+    case ExprKind::LITERAL:
+        return LiteralExpr::create(arena, static_cast<LiteralExpr *>(expr)->constant);
+    case ExprKind::VARIABLE: {
+        auto variable = static_cast<VariableExpr *>(expr);
+        // a body without blocks has its parameters as its only locals; the
+        // arguments themselves are copied with no arguments, as they are
+        if (variable->depth != -1 and not arguments.empty())
+            return substitute(arguments[variable->slot], {});
+        auto copy = VariableExpr::create(arena, variable->name);
+        copy->depth = variable->depth;
+        copy->slot = variable->slot;
+        return copy;
+    }
+    case ExprKind::GROUPING:
+        return GroupingExpr::create(
+                arena, substitute(static_cast<GroupingExpr *>(expr)->expr, arguments));
+    case ExprKind::UNARY: {
+        auto unary = static_cast<UnaryExpr *>(expr);
+        return UnaryExpr::create(arena, unary->op, substitute(unary->right, arguments));
+    }
+    case ExprKind::BINARY: {
+        auto binary = static_cast<BinaryExpr *>(expr);
+        return BinaryExpr::create(arena, substitute(binary->left, arguments), binary->op,
+                                  substitute(binary->right, arguments));
+    }
+    case ExprKind::LOGICAL: {
+        auto logical = static_cast<LogicalExpr *>(expr);
+        return LogicalExpr::create(arena, substitute(logical->left, arguments), logical->op,
+                                   substitute(logical->right, arguments));
+    }
+    default:
+        return expr;
+    }
+}
+
+// Expressions
+auto Inliner::visit(BinaryExpr *expr) -> Lit {
+    walk(expr->left);
+    walk(expr->right);
+    return nullptr;
+}
+
+auto Inliner::visit(LogicalExpr *expr) -> Lit {
+    walk(expr->left);
+    walk(expr->right);
+    return nullptr;
+}
+
+auto Inliner::visit(GroupingExpr *expr) -> Lit {
+    walk(expr->expr);
+    return nullptr;
+}
+
+auto Inliner::visit(LiteralExpr *) -> Lit {
+    return nullptr;
+}
+
+auto Inliner::visit(UnaryExpr *expr) -> Lit {
+    walk(expr->right);
+    return nullptr;
+}
+
+auto Inliner::visit(VariableExpr *) -> Lit {
+    return nullptr;
+}
+
+auto Inliner::visit(AssignExpr *expr) -> Lit {
+    if (collecting and expr->depth == -1)
+        assigned.insert(expr->name.symbol());
+    walk(expr->value);
+    return nullptr;
+}
+
+auto Inliner::visit(CallExpr *expr) -> Lit {
+    walk(expr->callee);
+    for (auto argument : expr->arguments)
+        walk(argument);
+    if (collecting or expr->callee->kind != ExprKind::VARIABLE)
+        return nullptr;
+
+    auto callee = static_cast<VariableExpr *>(expr->callee);
+    auto candidate = candidates.find(callee->name.symbol());
+    if (callee->depth != -1 or candidate == candidates.end())
+        return nullptr;
+
+    auto &[function, body, declared] = candidate->second;
+    if (declared >= current or expr->arguments.size() != function->params.size())
+        return nullptr;
+    for (auto argument : expr->arguments)
+        if (not atomic(argument))
+            return nullptr;
+
+    expr->inlined = substitute(body, expr->arguments);
+    return nullptr;
+}
+
+// Statements
+auto Inliner::visit(ExpressionStmt *stmt) -> void {
+    walk(stmt->expr);
+}
+
+auto Inliner::visit(PrintStmt *stmt) -> void {
+    walk(stmt->expr);
+}
+
+auto Inliner::visit(VarStmt *stmt) -> void {
+    walk(stmt->init);
+}
+
+auto Inliner::visit(BlockStmt *stmt) -> void {
+    for (auto statement : stmt->statements)
+        walk(statement);
+}
+
+auto Inliner::visit(WhileStmt *stmt) -> void {
+    walk(stmt->condition);
+    walk(stmt->body);
+}
+
+auto Inliner::visit(IfStmt *stmt) -> void {
+    walk(stmt->condition);
+    walk(stmt->thenBranch);
+    walk(stmt->elseBranch);
+}
+
+auto Inliner::visit(FunctionStmt *stmt) -> void {
+    for (auto statement : stmt->body)
+        walk(statement);
+}
+
+auto Inliner::visit(ReturnStmt *stmt) -> void {
+    walk(stmt->expr);
+}
+
+} // namespace lox
@@ -0,0 +1,92 @@
+#pragma once
+#include <span>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "../Parser/Arena.h"
+#include "../Parser/Expr.h"
+#include "../Parser/Stmt.h"
+
+namespace lox {
+
+// Replaces calls of small top level functions by their body (-O). A call
+// keeps its callee and arguments for the printers, CallExpr::inlined holds
+// the copy of the body the engines evaluate instead.
+//
+// Only what cannot be told apart from the call is inlined:
+//  - the function is declared at the top level before the statement that
+//    contains the call, and never assigned, so the callee is known
+//  - its body is a single return of at most BUDGET nodes without calls or
+//    assignments, so it is not recursive and has no effects
+//  - every argument is a literal, a local or a global declared before that
+//    statement: it cannot fail and nothing in the body can change it
+//
+// Parameters are not renamed but replaced: each reference to one becomes a
+// copy of its argument, resolved where the call is. The names the body
+// keeps are globals, resolved as such wherever the copy ends up, so a local
+// of the caller cannot capture them.
+class Inliner : public ExprStaticVisitor<Inliner>, public StmtStaticVisitor<Inliner> {
+  public:
+    typedef Types::Literal Lit;
+
+    // nodes of the returned expression of an inlined function
+    static constexpr int BUDGET = 12;
+
+  private:
+    struct Candidate {
+        FunctionStmt *function;
+        // the returned expression
+        Expr *body;
+        // top level statement that declares it
+        size_t declared;
+    };
+
+    Arena &arena;
+    // inlinable functions by symbol
+    std::unordered_map<int, Candidate> candidates;
+    // top level statement that declares each global, by symbol
+    std::unordered_map<int, size_t> globals;
+    // globals that are assigned somewhere
+    std::unordered_set<int> assigned;
+    // the first walk only collects the assigned globals
+    bool collecting = true;
+    // top level statement being walked
+    size_t current = 0;
+
+    auto walk(Expr *expr) -> void;
+    auto walk(Stmt *stmt) -> void;
+    auto walk(std::vector<Stmt *> &statements) -> void;
+    // nodes of an expression without calls and assignments, -1 otherwise
+    static auto size(Expr *expr) -> int;
+    auto atomic(Expr *argument) -> bool;
+    // copy of the body with the arguments in place of the parameters
+    auto substitute(Expr *expr, std::span<Expr *> arguments) -> Expr *;
+
+  public:
+    explicit Inliner(Arena &arena) : arena(arena) {}
+
+    auto inlineCalls(std::vector<Stmt *> &statements) -> void;
+
+    // Expressions
+    auto visit(BinaryExpr *expr) -> Lit;
+    auto visit(LogicalExpr *expr) -> Lit;
+    auto visit(GroupingExpr *expr) -> Lit;
+    auto visit(LiteralExpr *expr) -> Lit;
+    auto visit(UnaryExpr *expr) -> Lit;
+    auto visit(VariableExpr *expr) -> Lit;
+    auto visit(AssignExpr *expr) -> Lit;
+    auto visit(CallExpr *expr) -> Lit;
+
+    // Statements
+    auto visit(ExpressionStmt *stmt) -> void;
+    auto visit(PrintStmt *stmt) -> void;
+    auto visit(VarStmt *stmt) -> void;
+    auto visit(BlockStmt *stmt) -> void;
+    auto visit(WhileStmt *stmt) -> void;
+    auto visit(IfStmt *stmt) -> void;
+    auto visit(FunctionStmt *stmt) -> void;
+    auto visit(ReturnStmt *stmt) -> void;
+};
+
+} // namespace lox
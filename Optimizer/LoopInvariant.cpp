@@ -0,0 +1,311 @@
+#include <algorithm>
+#include <string>
+
+#include "LoopInvariant.h"
+#include "../Types/Symbols.h"
+
+namespace lox {
+
+using Types::Symbols;
+
+auto LoopInvariant::hoist(std::vector<Stmt *> &statements) -> void {
+    scope(statements, -1);
+}
+
+auto LoopInvariant::scope(std::vector<Stmt *> &statements, int next) -> int {
+    for (size_t i = 0; i < statements.size(); ++i) {
+        nested(statements[i]);
+        if (statements[i]->kind != StmtKind::WHILE)
+            continue;
+
+        if (next == -1) {
+            // globals have no slots, the bindings go in a block around the loop
+            this->next = 0;
+            auto bindings = loop(static_cast<WhileStmt *>(statements[i]));
+            if (bindings.empty())
+                continue;
+            bindings.push_back(statements[i]);
+            auto block = BlockStmt::create(arena, std::move(bindings));
+            block->frame = this->next;
+            statements[i] = block;
+            continue;
+        }
+
+        this->next = next;
+        auto bindings = loop(static_cast<WhileStmt *>(statements[i]));
+        next = this->next;
+        statements.insert(statements.begin() + i, bindings.begin(), bindings.end());
+        i += bindings.size();
+    }
+    return next;
+}
+
+auto LoopInvariant::nested(Stmt *stmt) -> void {
+    switch (stmt->kind) {
+    case StmtKind::BLOCK: {
+        // the bindings have to fit in its Frame
+        auto block = static_cast<BlockStmt *>(stmt);
+        int next = scope(block->statements, slots(block->statements));
+        if (block->frame != -1)
+            block->frame = std::max(block->frame, next);
+        break;
+    }
+    case StmtKind::FUNCTION: {
+        auto function = static_cast<FunctionStmt *>(stmt);
+        if (function->lazy)
+            break;
+        int params = function->params.size();
+        scope(function->body, std::max(params, slots(function->body)));
+        break;
+    }
+    case StmtKind::IF: {
+        auto branch = static_cast<IfStmt *>(stmt);
+        nested(branch->thenBranch);
+        if (branch->elseBranch)
+            nested(branch->elseBranch);
+        break;
+    }
+    case StmtKind::WHILE:
+        nested(static_cast<WhileStmt *>(stmt)->body);
+        break;
+    default:
+        break;
+    }
+}
+
+auto LoopInvariant::slots(std::vector<Stmt *> &statements) -> int {
+    int next = 0;
+    for (auto statement : statements) {
+        if (statement->kind == StmtKind::VAR)
+            next = std::max(next, static_cast<VarStmt *>(statement)->slot + 1);
+        else if (statement->kind == StmtKind::FUNCTION)
+            next = std::max(next, static_cast<FunctionStmt *>(statement)->slot + 1);
+    }
+    return next;
+}
+
+auto LoopInvariant::loop(WhileStmt *stmt) -> std::vector<Stmt *> {
+    assigned.clear();
+    hoisted.clear();
+
+    collecting = true;
+    walk(stmt);
+    collecting = false;
+    walk(stmt);
+    return std::move(hoisted);
+}
+
+auto LoopInvariant::walk(Expr *&expr) -> void {
+    if (not expr)
+        return;
+    if (not collecting and not trivial(expr) and invariant(expr) and effects.pure(expr)) {
+        expr = bind(expr);
+        return;
+    }
+    dispatchExpr(expr);
+}
+
+auto LoopInvariant::walk(Stmt *stmt) -> void {
+    if (stmt)
+        dispatchStmt(stmt);
+}
+
+auto LoopInvariant::invariant(Expr *expr) -> bool {
+    switch (expr->kind) {
+    case ExprKind::LITERAL:
+        return true;
+    case ExprKind::VARIABLE: {
+        // globals only pass Effects::pure as the callee of a native
+        auto variable = static_cast<VariableExpr *>(expr);
+        if (variable->depth == -1)
+            return true;
+        return variable->depth >= nesting
+               and not assigned.contains({variable->depth - nesting, variable->slot});
+    }
+    case ExprKind::GROUPING:
+        return invariant(static_cast<GroupingExpr *>(expr)->expr);
+    case ExprKind::UNARY:
+        return invariant(static_cast<UnaryExpr *>(expr)->right);
+    case ExprKind::BINARY: {
+        auto binary = static_cast<BinaryExpr *>(expr);
+        return invariant(binary->left) and invariant(binary->right);
+    }
+    case ExprKind::LOGICAL: {
+        auto logical = static_cast<LogicalExpr *>(expr);
+        return invariant(logical->left) and invariant(logical->right);
+    }
+    case ExprKind::CALL: {
+        auto call = static_cast<CallExpr *>(expr);
+        if (call->inlined)
+            return invariant(call->inlined);
+        return invariant(call->callee)
+               and std::all_of(call->arguments.begin(), call->arguments.end(),
+                               [this](Expr *argument) { return invariant(argument); });
+    }
+    default:
+        return false;
+    }
+}
+
+auto LoopInvariant::trivial(Expr *expr) -> bool {
+    switch (expr->kind) {
+    case ExprKind::LITERAL:
+    case ExprKind::VARIABLE:
+        return true;
+    case ExprKind::GROUPING:
+        return trivial(static_cast<GroupingExpr *>(expr)->expr);
+    case ExprKind::CALL: {
+        auto call = static_cast<CallExpr *>(expr);
+        return call->inlined and trivial(call->inlined);
+    }
+    default:
+        return false;
+    }
+}
+
+auto LoopInvariant::rebase(Expr *expr, int by) -> void {
+    switch (expr->kind) {
+    case ExprKind::VARIABLE: {
+        auto variable = static_cast<VariableExpr *>(expr);
+        if (variable->depth != -1)
+            variable->depth -= by;
+        break;
+    }
+    case ExprKind::GROUPING:
+        rebase(static_cast<GroupingExpr *>(expr)->expr, by);
+        break;
+    case ExprKind::UNARY:
+        rebase(static_cast<UnaryExpr *>(expr)->right, by);
+        break;
+    case ExprKind::BINARY: {
+        auto binary = static_cast<BinaryExpr *>(expr);
+        rebase(binary->left, by);
+        rebase(binary->right, by);
+        break;
+    }
+    case ExprKind::LOGICAL: {
+        auto logical = static_cast<LogicalExpr *>(expr);
+        rebase(logical->left, by);
+        rebase(logical->right, by);
+        break;
+    }
+    case ExprKind::CALL: {
+        // the arguments of an inlined call are only printed, but stay right
+        auto call = static_cast<CallExpr *>(expr);
+        rebase(call->callee, by);
+        for (auto argument : call->arguments)
+            rebase(argument, by);
+        if (call->inlined)
+            rebase(call->inlined, by);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+auto LoopInvariant::bind(Expr *expr) -> Expr * {
+    int symbol = Symbols::intern("(invariant " + std::to_string(bindings++) + ")");
+    Types::Token name(Types::IDENTIFIER, Symbols::name(symbol), -1, 0, 0, 0, symbol);
+
+    rebase(expr, nesting);
+    auto binding = VarStmt::create(arena, name, expr);
+    binding->slot = next++;
+    hoisted.push_back(binding);
+
+    auto variable = VariableExpr::create(arena, name);
+    variable->depth = nesting;
+    variable->slot = binding->slot;
+    return variable;
+}
+
+// Expressions
+auto LoopInvariant::visit(BinaryExpr *expr) -> Lit {
+    walk(expr->left);
+    walk(expr->right);
+    return nullptr;
+}
+
+auto LoopInvariant::visit(LogicalExpr *expr) -> Lit {
+    walk(expr->left);
+    walk(expr->right);
+    return nullptr;
+}
+
+auto LoopInvariant::visit(GroupingExpr *expr) -> Lit {
+    walk(expr->expr);
+    return nullptr;
+}
+
+auto LoopInvariant::visit(LiteralExpr *) -> Lit {
+    return nullptr;
+}
+
+auto LoopInvariant::visit(UnaryExpr *expr) -> Lit {
+    walk(expr->right);
+    return nullptr;
+}
+
+auto LoopInvariant::visit(VariableExpr *) -> Lit {
+    return nullptr;
+}
+
+auto LoopInvariant::visit(AssignExpr *expr) -> Lit {
+    if (collecting and expr->depth >= nesting)
+        assigned.emplace(expr->depth - nesting, expr->slot);
+    walk(expr->value);
+    return nullptr;
+}
+
+auto LoopInvariant::visit(CallExpr *expr) -> Lit {
+    // the engines evaluate only the inlined copy
+    if (expr->inlined) {
+        walk(expr->inlined);
+        return nullptr;
+    }
+    walk(expr->callee);
+    for (auto &argument : expr->arguments)
+        walk(argument);
+    return nullptr;
+}
+
+// Statements
+auto LoopInvariant::visit(ExpressionStmt *stmt) -> void {
+    walk(stmt->expr);
+}
+
+auto LoopInvariant::visit(PrintStmt *stmt) -> void {
+    walk(stmt->expr);
+}
+
+auto LoopInvariant::visit(VarStmt *stmt) -> void {
+    walk(stmt->init);
+}
+
+auto LoopInvariant::visit(BlockStmt *stmt) -> void {
+    ++nesting;
+    for (auto statement : stmt->statements)
+        walk(statement);
+    --nesting;
+}
+
+auto LoopInvariant::visit(WhileStmt *stmt) -> void {
+    walk(stmt->condition);
+    walk(stmt->body);
+}
+
+auto LoopInvariant::visit(IfStmt *stmt) -> void {
+    walk(stmt->condition);
+    walk(stmt->thenBranch);
+    walk(stmt->elseBranch);
+}
+
+auto LoopInvariant::visit(FunctionStmt *) -> void {
+    // its body sees none of the locals around it
+}
+
+auto LoopInvariant::visit(ReturnStmt *stmt) -> void {
+    walk(stmt->expr);
+}
+
+} // namespace lox
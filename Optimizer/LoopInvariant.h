@@ -0,0 +1,94 @@
+#pragma once
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "../Parser/Arena.h"
+#include "../Parser/Expr.h"
+#include "../Parser/Stmt.h"
+#include "Effects.h"
+
+namespace lox {
+
+// Moves what a loop computes the same way on every iteration in front of it
+// (-O). For a 'while', and so a desugared 'for', that is a statement of a
+// block or function body or of the program:
+//  - every largest subexpression of its condition and body that is pure and
+//    reads only locals declared outside the loop and never assigned in it
+//    is evaluated once, into a new local of that block or function body
+//    declared right before the loop, and read from there; at the top level
+//    the loop and its new locals are put in a block of their own
+//  - inner loops go first, so what they hoisted may move further out
+//
+// A loop may run zero times, so only what cannot fail or have an effect is
+// moved: clock, prn, print and any user function stay where they are.
+// Loops that are the whole branch of an 'if' or body of another loop have
+// no scope of their own to hoist into.
+class LoopInvariant : public ExprStaticVisitor<LoopInvariant>,
+                      public StmtStaticVisitor<LoopInvariant> {
+  public:
+    typedef Types::Literal Lit;
+
+  private:
+    Arena &arena;
+    const Effects &effects;
+
+    // locals the loop assigns, by depth from the loop and slot
+    std::set<std::pair<int, int>> assigned;
+    // bindings for the loop, in order
+    std::vector<Stmt *> hoisted;
+    // blocks between the loop and the node being walked
+    int nesting = 0;
+    // slot of the next binding in the scope of the loop
+    int next = 0;
+    // the first walk of a loop only collects what it assigns
+    bool collecting = true;
+    // names the bindings apart
+    int bindings = 0;
+
+    // the statements of a scope; next is -1 for the globals, whose loops
+    // get a block for their bindings. Returns the first slot after the
+    // bindings it added
+    auto scope(std::vector<Stmt *> &statements, int next) -> int;
+    // the scopes within a statement
+    auto nested(Stmt *stmt) -> void;
+    // first slot after the locals a scope declares
+    static auto slots(std::vector<Stmt *> &statements) -> int;
+    // returns the bindings to insert before the loop
+    auto loop(WhileStmt *stmt) -> std::vector<Stmt *>;
+
+    auto walk(Expr *&expr) -> void;
+    auto walk(Stmt *stmt) -> void;
+    auto invariant(Expr *expr) -> bool;
+    static auto trivial(Expr *expr) -> bool;
+    // makes the variables of a moved expression relative to its new place
+    static auto rebase(Expr *expr, int by) -> void;
+    auto bind(Expr *expr) -> Expr *;
+
+  public:
+    LoopInvariant(Arena &arena, const Effects &effects) : arena(arena), effects(effects) {}
+
+    auto hoist(std::vector<Stmt *> &statements) -> void;
+
+    // Expressions
+    auto visit(BinaryExpr *expr) -> Lit;
+    auto visit(LogicalExpr *expr) -> Lit;
+    auto visit(GroupingExpr *expr) -> Lit;
+    auto visit(LiteralExpr *expr) -> Lit;
+    auto visit(UnaryExpr *expr) -> Lit;
+    auto visit(VariableExpr *expr) -> Lit;
+    auto visit(AssignExpr *expr) -> Lit;
+    auto visit(CallExpr *expr) -> Lit;
+
+    // Statements
+    auto visit(ExpressionStmt *stmt) -> void;
+    auto visit(PrintStmt *stmt) -> void;
+    auto visit(VarStmt *stmt) -> void;
+    auto visit(BlockStmt *stmt) -> void;
+    auto visit(WhileStmt *stmt) -> void;
+    auto visit(IfStmt *stmt) -> void;
+    auto visit(FunctionStmt *stmt) -> void;
+    auto visit(ReturnStmt *stmt) -> void;
+};
+
+} // namespace lox
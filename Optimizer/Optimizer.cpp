@@ -0,0 +1,225 @@
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+#include "Optimizer.h"
+#include "../Environment/Environment.h"
+#include "../Interpreter/Interpreter.h"
+
+namespace lox {
+
+namespace {
+
+// Integer operations that are undefined in C++ and would trap or misbehave
+// while folding; at run time they do whatever they did before.
+auto undefined(const Types::Token &op, const Types::Value &left,
+               const Types::Value &right) -> bool {
+    using namespace Types;
+    if (not left.isNumber() or not right.isNumber()
+        or Value::promote(left.kind(), right.kind()) == Value::DOUBLE)
+        return false;
+
+    int lhs = left.toInt();
+    int rhs = right.toInt();
+    switch (op.type()) {
+    case SLASH:
+        return rhs == 0 or (lhs == INT_MIN and rhs == -1);
+    case SHIFT_LEFT:
+    case SHIFT_RIGHT:
+        return rhs < 0 or rhs >= 32;
+    default:
+        return false;
+    }
+}
+
+} // namespace
+
+auto Optimizer::optimize(std::vector<Stmt *> &statements) -> void {
+    for (auto &statement : statements)
+        statement = optimize(statement);
+    std::erase(statements, nullptr);
+}
+
+auto Optimizer::optimize(Expr *&expr) -> void {
+    if (not expr)
+        return;
+    dispatchExpr(expr);
+    if (folded)
+        expr = folded;
+    folded = nullptr;
+}
+
+auto Optimizer::optimize(Stmt *stmt) -> Stmt * {
+    rewritten = stmt;
+    dispatchStmt(stmt);
+    return std::exchange(rewritten, nullptr);
+}
+
+auto Optimizer::branch(Stmt *stmt) -> Stmt * {
+    if (not stmt)
+        return nullptr;
+    if (auto result = optimize(stmt))
+        return result;
+    auto empty = BlockStmt::create(arena, {});
+    empty->frame = 0;
+    return empty;
+}
+
+auto Optimizer::literal(Expr *expr) -> const Lit * {
+    if (expr->kind != ExprKind::LITERAL)
+        return nullptr;
+    return &constants[static_cast<LiteralExpr *>(expr)->constant];
+}
+
+auto Optimizer::make(Lit value) -> Expr * {
+    // the pool takes -0.0 for 0.0, which prints differently
+    if (value.kind() == Lit::DOUBLE and value.asDouble() == 0
+        and std::signbit(value.asDouble()))
+        return nullptr;
+    return LiteralExpr::create(arena, constants.add(std::move(value)));
+}
+
+// Expressions
+auto Optimizer::visit(BinaryExpr *expr) -> Lit {
+    optimize(expr->left);
+    optimize(expr->right);
+
+    auto left = literal(expr->left);
+    auto right = literal(expr->right);
+    if (not left or not right or undefined(expr->op, *left, *right))
+        return nullptr;
+
+    try {
+        folded = make(Interpreter::binary(expr->op, *left, *right));
+    } catch (RuntimeError &) {
+        // reported when the expression runs, if it ever does
+    }
+    return nullptr;
+}
+
+auto Optimizer::visit(LogicalExpr *expr) -> Lit {
+    optimize(expr->left);
+    optimize(expr->right);
+
+    auto left = literal(expr->left);
+    if (not left)
+        return nullptr;
+
+    bool decided = Interpreter::isTruthy(*left) == (expr->op.type() == Types::OR);
+    folded = decided ? expr->left : expr->right;
+    return nullptr;
+}
+
+auto Optimizer::visit(GroupingExpr *expr) -> Lit {
+    optimize(expr->expr);
+    folded = expr->expr;
+    return nullptr;
+}
+
+auto Optimizer::visit(LiteralExpr *) -> Lit {
+    return nullptr;
+}
+
+auto Optimizer::visit(UnaryExpr *expr) -> Lit {
+    optimize(expr->right);
+
+    auto right = literal(expr->right);
+    if (not right)
+        return nullptr;
+
+    switch (expr->op.type()) {
+    case Types::BANG:
+        folded = make(not Interpreter::isTruthy(*right));
+        break;
+    case Types::MINUS:
+        try {
+            folded = make(Interpreter::negate(expr->op, *right));
+        } catch (RuntimeError &) {
+        }
+        break;
+    default:
+        break;
+    }
+    return nullptr;
+}
+
+auto Optimizer::visit(VariableExpr *) -> Lit {
+    return nullptr;
+}
+
+auto Optimizer::visit(AssignExpr *expr) -> Lit {
+    optimize(expr->value);
+    return nullptr;
+}
+
+auto Optimizer::visit(CallExpr *expr) -> Lit {
+    if (expr->inlined) {
+        optimize(expr->inlined);
+        if (literal(expr->inlined))
+            folded = expr->inlined;
+        return nullptr;
+    }
+
+    optimize(expr->callee);
+    for (auto &argument : expr->arguments)
+        optimize(argument);
+    return nullptr;
+}
+
+// Statements
+auto Optimizer::visit(ExpressionStmt *stmt) -> void {
+    optimize(stmt->expr);
+    if (literal(stmt->expr))
+        rewritten = nullptr;
+}
+
+auto Optimizer::visit(PrintStmt *stmt) -> void {
+    optimize(stmt->expr);
+}
+
+auto Optimizer::visit(VarStmt *stmt) -> void {
+    optimize(stmt->init);
+}
+
+auto Optimizer::visit(BlockStmt *stmt) -> void {
+    optimize(stmt->statements);
+    rewritten = stmt;
+}
+
+auto Optimizer::visit(WhileStmt *stmt) -> void {
+    optimize(stmt->condition);
+    if (auto condition = literal(stmt->condition);
+        condition and not Interpreter::isTruthy(*condition)) {
+        rewritten = nullptr;
+        return;
+    }
+
+    stmt->body = branch(stmt->body);
+    rewritten = stmt;
+}
+
+auto Optimizer::visit(IfStmt *stmt) -> void {
+    optimize(stmt->condition);
+    if (auto condition = literal(stmt->condition)) {
+        auto taken = Interpreter::isTruthy(*condition) ? stmt->thenBranch
+                                                       : stmt->elseBranch;
+        rewritten = taken ? optimize(taken) : nullptr;
+        return;
+    }
+
+    stmt->thenBranch = branch(stmt->thenBranch);
+    stmt->elseBranch = branch(stmt->elseBranch);
+    rewritten = stmt;
+}
+
+auto Optimizer::visit(FunctionStmt *stmt) -> void {
+    if (not stmt->lazy)
+        optimize(stmt->body);
+    rewritten = stmt;
+}
+
+auto Optimizer::visit(ReturnStmt *stmt) -> void {
+    optimize(stmt->expr);
+}
+
+} // namespace lox
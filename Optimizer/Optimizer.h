@@ -0,0 +1,69 @@
+#pragma once
+#include <vector>
+
+#include "../Parser/Arena.h"
+#include "../Parser/Expr.h"
+#include "../Parser/Stmt.h"
+#include "../Types/Constants.h"
+
+namespace lox {
+
+// Rewrites a checked syntax tree in place before it runs (-O):
+//  - binary and unary operators on literals are evaluated once, with the
+//    Interpreter's own operations, and replaced by the resulting literal;
+//    anything that would fail or trap at run time is left to do so there
+//  - groupings are dropped, the nodes they enclose stay
+//  - 'and' / 'or' with a literal on the left become one of their operands
+//  - 'if' with a literal condition becomes the branch taken, 'while' with a
+//    false one and expression statements of a literal disappear
+//
+// New literals join the program's pool, new nodes its arena. Bodies that
+// the pre-parse skipped are not visited, so -O parses everything up front.
+class Optimizer : public ExprStaticVisitor<Optimizer>, public StmtStaticVisitor<Optimizer> {
+  public:
+    typedef Types::Literal Lit;
+
+  private:
+    Arena &arena;
+    Types::Constants &constants;
+    // what the expression being visited is replaced with, nullptr to keep it
+    Expr *folded = nullptr;
+    // what the statement being visited is replaced with, nullptr to drop it
+    Stmt *rewritten = nullptr;
+
+    auto optimize(Expr *&expr) -> void;
+    auto optimize(Stmt *stmt) -> Stmt *;
+    // a dropped branch or loop body still has to be a statement
+    auto branch(Stmt *stmt) -> Stmt *;
+    // value of a literal expression, nullptr for anything else
+    auto literal(Expr *expr) -> const Lit *;
+    auto make(Lit value) -> Expr *;
+
+  public:
+    Optimizer(Arena &arena, Types::Constants &constants)
+        : arena(arena), constants(constants) {}
+
+    auto optimize(std::vector<Stmt *> &statements) -> void;
+
+    // Expressions
+    auto visit(BinaryExpr *expr) -> Lit;
+    auto visit(LogicalExpr *expr) -> Lit;
+    auto visit(GroupingExpr *expr) -> Lit;
+    auto visit(LiteralExpr *expr) -> Lit;
+    auto visit(UnaryExpr *expr) -> Lit;
+    auto visit(VariableExpr *expr) -> Lit;
+    auto visit(AssignExpr *expr) -> Lit;
+    auto visit(CallExpr *expr) -> Lit;
+
+    // Statements
+    auto visit(ExpressionStmt *stmt) -> void;
+    auto visit(PrintStmt *stmt) -> void;
+    auto visit(VarStmt *stmt) -> void;
+    auto visit(BlockStmt *stmt) -> void;
+    auto visit(WhileStmt *stmt) -> void;
+    auto visit(IfStmt *stmt) -> void;
+    auto visit(FunctionStmt *stmt) -> void;
+    auto visit(ReturnStmt *stmt) -> void;
+};
+
+} // namespace lox
@@ -0,0 +1,222 @@
+#include <algorithm>
+#include <utility>
+
+#include "TypeInference.h"
+
+namespace lox {
+
+using Types::Value;
+
+auto TypeInference::join(Type lhs, Type rhs) -> Type {
+    if (lhs == UNSET)
+        return rhs;
+    if (rhs == UNSET or lhs == rhs)
+        return lhs;
+    return ANY;
+}
+
+auto TypeInference::join(State &into, const State &from) -> bool {
+    bool changed = false;
+    for (size_t scope = 0; scope < into.size() and scope < from.size(); ++scope) {
+        auto &slots = into[scope];
+        if (slots.size() < from[scope].size())
+            slots.resize(from[scope].size(), UNSET);
+        for (size_t slot = 0; slot < from[scope].size(); ++slot) {
+            Type joined = join(slots[slot], from[scope][slot]);
+            changed |= joined != slots[slot];
+            slots[slot] = joined;
+        }
+    }
+    return changed;
+}
+
+// Type of what Interpreter::binary returns for operands of these types,
+// when it returns at all.
+auto TypeInference::result(const Types::Token &op, Type left, Type right) -> Type {
+    using namespace Types;
+    if (op.type() == EQUAL_EQUAL or op.type() == BANG_EQUAL)
+        return Value::BOOL;
+    if (left == Value::STRING)
+        return Value::STRING;
+
+    auto number = [](Type type) {
+        return type == Value::INT or type == Value::DOUBLE or type == Value::BYTE;
+    };
+    if (not number(left) or not number(right))
+        return ANY;
+
+    switch (op.type()) {
+    case GREATER:
+    case GREATER_EQUAL:
+    case LESS:
+    case LESS_EQUAL:
+        return Value::BOOL;
+    default:
+        // bytes are computed as integers
+        auto kind = Value::promote((Value::Kind)left, (Value::Kind)right);
+        return kind == Value::DOUBLE ? Value::DOUBLE : Value::INT;
+    }
+}
+
+auto TypeInference::infer(std::vector<Stmt *> &statements) -> void {
+    for (auto statement : statements)
+        infer(statement);
+}
+
+auto TypeInference::infer(Expr *expr) -> Type {
+    dispatchExpr(expr);
+    return type;
+}
+
+auto TypeInference::infer(Stmt *stmt) -> void {
+    dispatchStmt(stmt);
+}
+
+auto TypeInference::local(int depth, int slot) -> Type & {
+    if (depth < 0 or (size_t)depth >= state.size()) {
+        unknown = ANY;
+        return unknown;
+    }
+    auto &slots = state[state.size() - 1 - depth];
+    if ((size_t)slot >= slots.size())
+        slots.resize(slot + 1, UNSET);
+    return slots[slot];
+}
+
+// Expressions
+auto TypeInference::visit(BinaryExpr *expr) -> Lit {
+    Type left = infer(expr->left);
+    Type right = infer(expr->right);
+
+    bool proven = left == right and (left == Value::INT or left == Value::DOUBLE);
+    expr->operands = proven ? (Value::Kind)left : Value::NIL;
+    type = result(expr->op, left, right);
+    return nullptr;
+}
+
+auto TypeInference::visit(LogicalExpr *expr) -> Lit {
+    Type left = infer(expr->left);
+
+    // the right operand may not run
+    State skipped = state;
+    Type right = infer(expr->right);
+    join(state, skipped);
+
+    type = join(left, right);
+    return nullptr;
+}
+
+auto TypeInference::visit(GroupingExpr *expr) -> Lit {
+    infer(expr->expr);
+    return nullptr;
+}
+
+auto TypeInference::visit(LiteralExpr *expr) -> Lit {
+    type = constants[expr->constant].kind();
+    return nullptr;
+}
+
+auto TypeInference::visit(UnaryExpr *expr) -> Lit {
+    Type right = infer(expr->right);
+
+    if (expr->op.type() == Types::BANG)
+        type = Value::BOOL;
+    else if (right == Value::INT or right == Value::DOUBLE or right == Value::BYTE)
+        type = right;
+    else
+        type = ANY;
+    return nullptr;
+}
+
+auto TypeInference::visit(VariableExpr *expr) -> Lit {
+    type = local(expr->depth, expr->slot);
+    return nullptr;
+}
+
+auto TypeInference::visit(AssignExpr *expr) -> Lit {
+    Type value = infer(expr->value);
+    local(expr->depth, expr->slot) = value;
+    type = value;
+    return nullptr;
+}
+
+auto TypeInference::visit(CallExpr *expr) -> Lit {
+    if (expr->inlined) {
+        infer(expr->inlined);
+        return nullptr;
+    }
+
+    infer(expr->callee);
+    for (auto argument : expr->arguments)
+        infer(argument);
+    type = ANY;
+    return nullptr;
+}
+
+// Statements
+auto TypeInference::visit(ExpressionStmt *stmt) -> void {
+    infer(stmt->expr);
+}
+
+auto TypeInference::visit(PrintStmt *stmt) -> void {
+    infer(stmt->expr);
+}
+
+auto TypeInference::visit(VarStmt *stmt) -> void {
+    Type init = stmt->init ? infer(stmt->init) : Type(Value::NIL);
+    if (stmt->slot != -1)
+        local(0, stmt->slot) = init;
+}
+
+auto TypeInference::visit(BlockStmt *stmt) -> void {
+    state.emplace_back();
+    infer(stmt->statements);
+    state.pop_back();
+}
+
+auto TypeInference::visit(WhileStmt *stmt) -> void {
+    // the body is walked again until the state at the condition is stable,
+    // so the marks of the last walk hold for every iteration
+    State head = state;
+    for (;;) {
+        state = head;
+        infer(stmt->condition);
+        State exit = state;
+        infer(stmt->body);
+        if (not join(head, state)) {
+            state = std::move(exit);
+            return;
+        }
+    }
+}
+
+auto TypeInference::visit(IfStmt *stmt) -> void {
+    infer(stmt->condition);
+
+    State otherwise = state;
+    infer(stmt->thenBranch);
+    std::swap(state, otherwise);
+    if (stmt->elseBranch)
+        infer(stmt->elseBranch);
+    join(state, otherwise);
+}
+
+auto TypeInference::visit(FunctionStmt *stmt) -> void {
+    if (stmt->slot != -1)
+        local(0, stmt->slot) = Value::CALLABLE;
+    if (stmt->lazy)
+        return;
+
+    // the body sees its parameters and the globals only
+    State outer = std::exchange(state, State(1));
+    state[0].assign(stmt->params.size(), ANY);
+    infer(stmt->body);
+    state = std::move(outer);
+}
+
+auto TypeInference::visit(ReturnStmt *stmt) -> void {
+    if (stmt->expr)
+        infer(stmt->expr);
+}
+
+} // namespace lox
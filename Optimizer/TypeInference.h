@@ -0,0 +1,78 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "../Parser/Expr.h"
+#include "../Parser/Stmt.h"
+#include "../Types/Constants.h"
+
+namespace lox {
+
+// Proves which kind of value local variables and expressions hold (-O).
+// There are no closures, so a local only changes through assignments in
+// the function that declares it and is followed statement by statement:
+// the two sides of a branch are joined, loops are walked until the state
+// at their condition no longer changes. Globals may be changed by any call
+// and are never proven.
+//
+// Binary expressions with both operands proven INT, or both DOUBLE, are
+// marked in BinaryExpr::operands; the engines then run the operation
+// directly, without kind checks and promotion.
+class TypeInference : public ExprStaticVisitor<TypeInference>, public StmtStaticVisitor<TypeInference> {
+  public:
+    typedef Types::Literal Lit;
+    // a Types::Value::Kind, or one of the ends of the lattice
+    typedef uint8_t Type;
+    // no value has reached it yet
+    static constexpr Type UNSET = 0xfe;
+    // may be of any kind
+    static constexpr Type ANY = 0xff;
+
+  private:
+    // types of the locals, one list of slots per environment, innermost last
+    typedef std::vector<std::vector<Type>> State;
+
+    const Types::Constants &constants;
+    State state;
+    // type of the last visited expression
+    Type type = ANY;
+    // stands in for locals outside of the state, which are not proven
+    Type unknown = ANY;
+
+    static auto join(Type lhs, Type rhs) -> Type;
+    // joins from into into, false when into did not change
+    static auto join(State &into, const State &from) -> bool;
+    static auto result(const Types::Token &op, Type left, Type right) -> Type;
+
+    auto infer(Expr *expr) -> Type;
+    auto infer(Stmt *stmt) -> void;
+    auto local(int depth, int slot) -> Type &;
+
+  public:
+    explicit TypeInference(const Types::Constants &constants)
+        : constants(constants) {}
+
+    auto infer(std::vector<Stmt *> &statements) -> void;
+
+    // Expressions
+    auto visit(BinaryExpr *expr) -> Lit;
+    auto visit(LogicalExpr *expr) -> Lit;
+    auto visit(GroupingExpr *expr) -> Lit;
+    auto visit(LiteralExpr *expr) -> Lit;
+    auto visit(UnaryExpr *expr) -> Lit;
+    auto visit(VariableExpr *expr) -> Lit;
+    auto visit(AssignExpr *expr) -> Lit;
+    auto visit(CallExpr *expr) -> Lit;
+
+    // Statements
+    auto visit(ExpressionStmt *stmt) -> void;
+    auto visit(PrintStmt *stmt) -> void;
+    auto visit(VarStmt *stmt) -> void;
+    auto visit(BlockStmt *stmt) -> void;
+    auto visit(WhileStmt *stmt) -> void;
+    auto visit(IfStmt *stmt) -> void;
+    auto visit(FunctionStmt *stmt) -> void;
+    auto visit(ReturnStmt *stmt) -> void;
+};
+
+} // namespace lox
@@ -0,0 +1,82 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace lox {
+
+// Bump-pointer allocator for syntax tree nodes. Nodes are placed one after
+// another in large blocks and are released all together with the arena.
+class Arena {
+    static constexpr std::size_t BLOCK_SIZE = 64 * 1024;
+
+    struct Finalizer {
+        void *object;
+        void (*destroy)(void *);
+    };
+
+    std::vector<std::unique_ptr<std::byte[]>> blocks;
+    std::vector<Finalizer> finalizers;
+    std::byte *cursor = nullptr;
+    std::byte *end = nullptr;
+
+  public:
+    Arena() = default;
+    Arena(Arena &&) = default;
+    Arena(const Arena &) = delete;
+    auto operator=(const Arena &) -> Arena & = delete;
+    auto operator=(Arena &&) -> Arena & = delete;
+
+    ~Arena() {
+        for (auto it = finalizers.rbegin(); it != finalizers.rend(); ++it)
+            it->destroy(it->object);
+    }
+
+    auto allocate(std::size_t size, std::size_t align) -> void * {
+        auto address = reinterpret_cast<std::uintptr_t>(cursor);
+        auto padding = (align - address % align) % align;
+
+        if (cursor == nullptr or (std::size_t)(end - cursor) < size + padding) {
+            // oversized requests get a block of their own
+            auto capacity = std::max(BLOCK_SIZE, size + align);
+            blocks.push_back(std::make_unique_for_overwrite<std::byte[]>(capacity));
+            cursor = blocks.back().get();
+            end = cursor + capacity;
+
+            address = reinterpret_cast<std::uintptr_t>(cursor);
+            padding = (align - address % align) % align;
+        }
+
+        void *memory = cursor + padding;
+        cursor += padding + size;
+        return memory;
+    }
+
+    // takes over the nodes of other, which is left empty
+    auto adopt(Arena &&other) -> void {
+        for (auto &block : other.blocks)
+            blocks.push_back(std::move(block));
+        finalizers.insert(finalizers.end(), other.finalizers.begin(),
+                          other.finalizers.end());
+        other.blocks.clear();
+        other.finalizers.clear();
+        other.cursor = other.end = nullptr;
+    }
+
+    template <class T, class... Args> auto make(Args &&...args) -> T * {
+        void *memory = allocate(sizeof(T), alignof(T));
+        T *object = new (memory) T(std::forward<Args>(args)...);
+
+        if constexpr (!std::is_trivially_destructible_v<T>)
+            finalizers.push_back(
+                {object, [](void *object) { static_cast<T *>(object)->~T(); }});
+        return object;
+    }
+};
+
+} // namespace lox
@@ -1,11 +1,15 @@
 // This file was generated by GenerateAst
 #pragma once
+#include <cstdint>
+#include <utility>
+#include <vector>
+
 #include "../Types/Token.h"
-#include <functional>
-#include <type_traits>
+#include "Arena.h"
 
 using namespace lox;
 
+class Expr;
 class BinaryExpr;
 class GroupingExpr;
 class LiteralExpr;
@@ -15,6 +19,17 @@ class AssignExpr;
 class LogicalExpr;
 class CallExpr;
 
+enum class ExprKind : uint8_t {
+    BINARY,
+    GROUPING,
+    LITERAL,
+    UNARY,
+    VARIABLE,
+    ASSIGN,
+    LOGICAL,
+    CALL,
+};
+
 class ExprVisitor {
 public:
     virtual ~ExprVisitor() = default;
@@ -28,62 +43,88 @@ public:
     virtual Types::Literal visit(CallExpr* expr) = 0;
 };
 
+// Visitor without virtual calls: dispatchExpr() switches on the kind
+// and calls Derived::visit directly, where it can be inlined.
+template <class Derived>
+class ExprStaticVisitor {
+public:
+    Types::Literal dispatchExpr(Expr* expr);
+};
+
 class Expr {
 public:
-    virtual ~Expr() = default;
+    const ExprKind kind;
+
     virtual Types::Literal accept(ExprVisitor* visitor) = 0;
+
+protected:
+    Expr(ExprKind kind) : kind(kind) { }
+    // nodes are owned by an Arena and never deleted through the base,
+    // so the ones without heap members need no finalizer
+    ~Expr() = default;
 };
 
-class CallExpr : public Expr {
+class BinaryExpr : public Expr {
 public:
-    Expr* callee;
-    Types::Token paren;
-    std::vector<Expr*> arguments;
+    Expr* left;
+    Types::Token op;
+    Expr* right;
+    // INT or DOUBLE when TypeInference proved both operands to be of that kind
+    Types::Value::Kind operands = Types::Value::NIL;
 
-    CallExpr(Expr* callee, Types::Token paren, std::vector<Expr*> arguments) :
-        callee(callee), paren(paren), arguments(arguments)
+    BinaryExpr(Expr* left, Types::Token op, Expr* right) :
+        Expr(ExprKind::BINARY), left(left), op(op), right(right)
     { }
+    static BinaryExpr* create(Arena& arena, Expr* left, Types::Token op, Expr* right) {
+        return arena.make<BinaryExpr>(left, op, right);
+    }
     Types::Literal accept(ExprVisitor* visitor) override {
         return visitor->visit(this);
     };
 };
 
-class LogicalExpr : public Expr {
+class GroupingExpr : public Expr {
 public:
-    Expr* left;
-    Types::Token op;
-    Expr* right;
+    Expr* expr;
 
-    LogicalExpr(Expr* left, Types::Token op, Expr* right) :
-        left(left), op(op), right(right)
+    GroupingExpr(Expr* expr) :
+        Expr(ExprKind::GROUPING), expr(expr)
     { }
+    static GroupingExpr* create(Arena& arena, Expr* expr) {
+        return arena.make<GroupingExpr>(expr);
+    }
     Types::Literal accept(ExprVisitor* visitor) override {
         return visitor->visit(this);
     };
 };
 
-class AssignExpr : public Expr {
+class LiteralExpr : public Expr {
 public:
-    Types::Token name;
-    Expr* value;
+    // index into the program's Types::Constants
+    int constant;
 
-    AssignExpr(Types::Token name, Expr* value) :
-        name(name), value(value)
+    LiteralExpr(int constant) :
+        Expr(ExprKind::LITERAL), constant(constant)
     { }
+    static LiteralExpr* create(Arena& arena, int constant) {
+        return arena.make<LiteralExpr>(constant);
+    }
     Types::Literal accept(ExprVisitor* visitor) override {
         return visitor->visit(this);
     };
 };
 
-class BinaryExpr : public Expr {
+class UnaryExpr : public Expr {
 public:
-    Expr* left;
     Types::Token op;
     Expr* right;
 
-    BinaryExpr(Expr* left, Types::Token op, Expr* right) :
-        left(left), op(op), right(right)
+    UnaryExpr(Types::Token op, Expr* right) :
+        Expr(ExprKind::UNARY), op(op), right(right)
     { }
+    static UnaryExpr* create(Arena& arena, Types::Token op, Expr* right) {
+        return arena.make<UnaryExpr>(op, right);
+    }
     Types::Literal accept(ExprVisitor* visitor) override {
         return visitor->visit(this);
     };
@@ -92,48 +133,88 @@ public:
 class VariableExpr : public Expr {
 public:
     Types::Token name;
+    // resolved by Checker, depth -1 means global
+    int depth = -1;
+    int slot = -1;
 
-    VariableExpr(Types::Token token) :
-        name(token)
+    VariableExpr(Types::Token name) :
+        Expr(ExprKind::VARIABLE), name(name)
     { }
+    static VariableExpr* create(Arena& arena, Types::Token name) {
+        return arena.make<VariableExpr>(name);
+    }
     Types::Literal accept(ExprVisitor* visitor) override {
         return visitor->visit(this);
     };
 };
 
-class GroupingExpr : public Expr {
+class AssignExpr : public Expr {
 public:
-    Expr* expr;
+    Types::Token name;
+    Expr* value;
+    // resolved by Checker, depth -1 means global
+    int depth = -1;
+    int slot = -1;
 
-    GroupingExpr(Expr* expr) :
-        expr(expr)
+    AssignExpr(Types::Token name, Expr* value) :
+        Expr(ExprKind::ASSIGN), name(name), value(value)
     { }
+    static AssignExpr* create(Arena& arena, Types::Token name, Expr* value) {
+        return arena.make<AssignExpr>(name, value);
+    }
     Types::Literal accept(ExprVisitor* visitor) override {
         return visitor->visit(this);
     };
 };
 
-class LiteralExpr : public Expr {
+class LogicalExpr : public Expr {
 public:
-    Types::Literal value;
+    Expr* left;
+    Types::Token op;
+    Expr* right;
 
-    LiteralExpr(Types::Literal literal) :
-        value(literal)
+    LogicalExpr(Expr* left, Types::Token op, Expr* right) :
+        Expr(ExprKind::LOGICAL), left(left), op(op), right(right)
     { }
+    static LogicalExpr* create(Arena& arena, Expr* left, Types::Token op, Expr* right) {
+        return arena.make<LogicalExpr>(left, op, right);
+    }
     Types::Literal accept(ExprVisitor* visitor) override {
         return visitor->visit(this);
     };
 };
 
-class UnaryExpr : public Expr {
+class CallExpr : public Expr {
 public:
-    Types::Token op;
-    Expr* right;
+    Expr* callee;
+    Types::Token paren;
+    std::vector<Expr*> arguments;
+    // body of the callee with the arguments in place of the parameters, evaluated instead of the call; set by Inliner
+    Expr* inlined = nullptr;
 
-    UnaryExpr(Types::Token op, Expr* right) :
-        op(op), right(right)
+    CallExpr(Expr* callee, Types::Token paren, std::vector<Expr*> arguments) :
+        Expr(ExprKind::CALL), callee(callee), paren(paren), arguments(std::move(arguments))
     { }
+    static CallExpr* create(Arena& arena, Expr* callee, Types::Token paren, std::vector<Expr*> arguments) {
+        return arena.make<CallExpr>(callee, paren, std::move(arguments));
+    }
     Types::Literal accept(ExprVisitor* visitor) override {
         return visitor->visit(this);
     };
 };
+
+template <class Derived>
+inline Types::Literal ExprStaticVisitor<Derived>::dispatchExpr(Expr* expr) {
+    auto self = static_cast<Derived*>(this);
+    switch (expr->kind) {
+    case ExprKind::BINARY: return self->visit(static_cast<BinaryExpr*>(expr));
+    case ExprKind::GROUPING: return self->visit(static_cast<GroupingExpr*>(expr));
+    case ExprKind::LITERAL: return self->visit(static_cast<LiteralExpr*>(expr));
+    case ExprKind::UNARY: return self->visit(static_cast<UnaryExpr*>(expr));
+    case ExprKind::VARIABLE: return self->visit(static_cast<VariableExpr*>(expr));
+    case ExprKind::ASSIGN: return self->visit(static_cast<AssignExpr*>(expr));
+    case ExprKind::LOGICAL: return self->visit(static_cast<LogicalExpr*>(expr));
+    case ExprKind::CALL: return self->visit(static_cast<CallExpr*>(expr));
+    }
+    return Types::Literal();
+}
@@ -0,0 +1,205 @@
+#include "FlatAst.h"
+#include "Parser.h"
+
+using namespace lox;
+using namespace lox::flat;
+
+namespace {
+
+// Walks the pointer tree once and appends every node in preorder.
+class Flattener : public ExprVisitor, public StmtVisitor {
+    typedef Types::Literal Lit;
+
+    Tree &tree;
+    // node built by the last visit
+    Index result = NONE;
+
+    auto add(Kind kind) -> Index {
+        tree.nodes.push_back({kind});
+        return tree.nodes.size() - 1;
+    }
+    auto add(Kind kind, const Types::Token &name) -> Index {
+        Index node = add(kind);
+        tree[node].token = token(name);
+        return node;
+    }
+    auto token(const Types::Token &token) -> Index {
+        tree.tokens.push_back({(uint32_t)token.offset(), (uint32_t)token.line(),
+                               token.symbol(), (uint16_t)token.length(),
+                               (uint8_t)token.type()});
+        return tree.tokens.size() - 1;
+    }
+
+    // the slots of a list are reserved before its items are flattened, so
+    // lists nested in the items land behind it
+    template <class Item> auto list(const std::vector<Item *> &items) -> Index {
+        Index list = tree.lists.size();
+        tree.lists.push_back(items.size());
+        tree.lists.resize(list + 1 + items.size());
+        for (size_t i = 0; i < items.size(); ++i) {
+            Index item = flatten(items[i]);
+            tree.lists[list + 1 + i] = item;
+        }
+        return list;
+    }
+
+  public:
+    Flattener(Tree &tree) : tree(tree) {}
+
+    auto flatten(Expr *expr) -> Index {
+        if (!expr)
+            return NONE;
+        expr->accept(this);
+        return result;
+    }
+    auto flatten(Stmt *stmt) -> Index {
+        if (!stmt)
+            return NONE;
+        stmt->accept(this);
+        return result;
+    }
+    auto flatten(const std::vector<Stmt *> &statements) -> Index {
+        return list(statements);
+    }
+
+    // Expressions
+    auto visit(BinaryExpr *expr) -> Lit override {
+        Index node = add(BINARY, expr->op);
+        Index left = flatten(expr->left);
+        Index right = flatten(expr->right);
+        tree[node].a = left;
+        tree[node].b = right;
+        if (expr->operands != Types::Value::NIL)
+            tree[node].c = expr->operands;
+        result = node;
+        return nullptr;
+    }
+    auto visit(LogicalExpr *expr) -> Lit override {
+        Index node = add(LOGICAL, expr->op);
+        Index left = flatten(expr->left);
+        Index right = flatten(expr->right);
+        tree[node].a = left;
+        tree[node].b = right;
+        result = node;
+        return nullptr;
+    }
+    auto visit(GroupingExpr *expr) -> Lit override {
+        Index node = add(GROUPING);
+        Index inner = flatten(expr->expr);
+        tree[node].a = inner;
+        result = node;
+        return nullptr;
+    }
+    auto visit(LiteralExpr *expr) -> Lit override {
+        result = add(LITERAL);
+        tree[result].a = expr->constant;
+        return nullptr;
+    }
+    auto visit(UnaryExpr *expr) -> Lit override {
+        Index node = add(UNARY, expr->op);
+        Index right = flatten(expr->right);
+        tree[node].a = right;
+        result = node;
+        return nullptr;
+    }
+    auto visit(VariableExpr *expr) -> Lit override {
+        result = add(VARIABLE, expr->name);
+        tree[result].a = expr->depth;
+        tree[result].b = expr->slot;
+        return nullptr;
+    }
+    auto visit(AssignExpr *expr) -> Lit override {
+        Index node = add(ASSIGN, expr->name);
+        Index value = flatten(expr->value);
+        tree[node].a = value;
+        tree[node].b = expr->depth;
+        tree[node].c = expr->slot;
+        result = node;
+        return nullptr;
+    }
+    auto visit(CallExpr *expr) -> Lit override {
+        Index node = add(CALL, expr->paren);
+        Index callee = flatten(expr->callee);
+        Index arguments = list(expr->arguments);
+        tree[node].a = callee;
+        tree[node].b = arguments;
+        if (expr->inlined) {
+            Index inlined = flatten(expr->inlined);
+            tree[node].c = inlined;
+        }
+        result = node;
+        return nullptr;
+    }
+
+    // Statements
+    auto visit(ExpressionStmt *stmt) -> void override {
+        Index node = add(EXPRESSION);
+        Index expr = flatten(stmt->expr);
+        tree[node].a = expr;
+        result = node;
+    }
+    auto visit(PrintStmt *stmt) -> void override {
+        Index node = add(PRINT);
+        Index expr = flatten(stmt->expr);
+        tree[node].a = expr;
+        result = node;
+    }
+    auto visit(VarStmt *stmt) -> void override {
+        Index node = add(VAR, stmt->name);
+        Index init = flatten(stmt->init);
+        tree[node].a = init;
+        tree[node].b = stmt->slot;
+        result = node;
+    }
+    auto visit(BlockStmt *stmt) -> void override {
+        Index node = add(BLOCK);
+        Index statements = list(stmt->statements);
+        tree[node].a = statements;
+        tree[node].b = stmt->frame == -1 ? NONE : stmt->frame;
+        result = node;
+    }
+    auto visit(IfStmt *stmt) -> void override {
+        Index node = add(IF);
+        Index condition = flatten(stmt->condition);
+        Index thenBranch = flatten(stmt->thenBranch);
+        Index elseBranch = flatten(stmt->elseBranch);
+        tree[node].a = condition;
+        tree[node].b = thenBranch;
+        tree[node].c = elseBranch;
+        result = node;
+    }
+    auto visit(WhileStmt *stmt) -> void override {
+        Index node = add(WHILE);
+        Index condition = flatten(stmt->condition);
+        Index body = flatten(stmt->body);
+        tree[node].a = condition;
+        tree[node].b = body;
+        result = node;
+    }
+    auto visit(FunctionStmt *stmt) -> void override {
+        Index node = add(FUNCTION, stmt->name);
+        for (auto &param : stmt->params)
+            token(param);
+        Index body = list(stmt->body);
+        tree[node].a = stmt->params.size();
+        tree[node].b = body;
+        tree[node].c = stmt->slot;
+        result = node;
+    }
+    auto visit(ReturnStmt *stmt) -> void override {
+        Index node = add(RETURN, stmt->keyword);
+        Index value = flatten(stmt->expr);
+        tree[node].a = value;
+        result = node;
+    }
+};
+
+} // namespace
+
+auto flat::flatten(const Program &program) -> Tree {
+    Tree tree;
+    tree.source = program.source;
+    tree.constants = program.constants;
+    tree.statements = Flattener(tree).flatten(program.statements);
+    return tree;
+}
@@ -0,0 +1,115 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "../Scanner/Source.h"
+#include "../Types/Constants.h"
+#include "../Types/Token.h"
+
+namespace lox {
+
+class Program;
+
+namespace flat {
+
+// Alternative form of the syntax tree: every node of a program in one
+// array, children referenced by index. The walkers that understand it
+// (Checker, Interpreter, AstPrinter, IdPrinter) switch on the kind instead
+// of going through the visitors.
+
+enum Kind : uint8_t {
+    // expressions
+    BINARY, GROUPING, LITERAL, UNARY, VARIABLE, ASSIGN, LOGICAL, CALL,
+    // statements
+    EXPRESSION, PRINT, VAR, BLOCK, IF, WHILE, FUNCTION, RETURN,
+};
+
+// index of a node, a token or a list in a Tree
+typedef uint32_t Index;
+inline constexpr Index NONE = UINT32_MAX;
+
+// What token, a, b and c hold depends on the kind:
+//
+//   BINARY             token: operator   a: left        b: right   c: operands
+//   LOGICAL            token: operator   a: left        b: right
+//   GROUPING                             a: expr
+//   LITERAL                              a: constant
+//   UNARY              token: operator   a: right
+//   VARIABLE           token: name       a: depth       b: slot
+//   ASSIGN             token: name       a: value       b: depth   c: slot
+//   CALL               token: paren      a: callee      b: arguments c: inlined
+//   EXPRESSION, PRINT                    a: expr
+//   VAR                token: name       a: init        b: slot
+//   BLOCK                                a: statements  b: frame
+//   IF                                   a: condition   b: then    c: else
+//   WHILE                                a: condition   b: body
+//   FUNCTION           token: name       a: arity       b: body    c: slot
+//   RETURN             token: keyword    a: value
+//
+// Missing children are NONE. The operands of a BINARY are the Value::Kind
+// TypeInference proved both of them to have, NONE when it proved nothing.
+// The frame of a BLOCK is the number of its slots, NONE until the Checker
+// counts them. The inlined expression of a CALL
+// is evaluated instead of the call. Depth and slot are stored as unsigned and
+// read back as -1 (global) until the Checker resolves them. The parameters
+// of a function are the tokens right after its name.
+struct Node {
+    Kind kind;
+    Index token = NONE;
+    Index a = NONE, b = NONE, c = NONE;
+};
+
+// A token without its lexeme, which is cut from the source on demand.
+struct TokenRecord {
+    uint32_t offset;
+    uint32_t line;
+    int32_t symbol;
+    uint16_t length;
+    uint8_t type;
+};
+
+class Tree {
+  public:
+    // depth-first, a node comes before its children
+    std::vector<Node> nodes;
+    std::vector<TokenRecord> tokens;
+    // node lists, each stored as its length followed by the node indices
+    std::vector<Index> lists;
+    // list of the top level statements
+    Index statements = NONE;
+
+    // tokens are views into this buffer
+    std::shared_ptr<const Source> source;
+    std::shared_ptr<const Types::Constants> constants;
+
+    auto operator[](Index node) -> Node & { return nodes[node]; }
+    auto operator[](Index node) const -> const Node & { return nodes[node]; }
+
+    auto list(Index list) const -> std::span<const Index> {
+        return {lists.data() + list + 1, lists[list]};
+    }
+
+    auto token(Index index) const -> Types::Token {
+        auto &record = tokens[index];
+        return Types::Token(Types::TokenType(record.type),
+                            source->text().substr(record.offset, record.length),
+                            -1, record.line, record.offset, record.length,
+                            record.symbol);
+    }
+
+    // bytes held by the arrays
+    auto size() const -> size_t {
+        return nodes.size() * sizeof(Node) +
+               tokens.size() * sizeof(TokenRecord) +
+               lists.size() * sizeof(Index);
+    }
+};
+
+// Copies the syntax tree of a parsed program into flat form.
+auto flatten(const Program &program) -> Tree;
+
+} // namespace flat
+} // namespace lox
@@ -0,0 +1,54 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "../Scanner/Source.h"
+#include "../Types/Constants.h"
+#include "Arena.h"
+
+class FunctionStmt;
+
+namespace lox {
+
+class Checker;
+
+// Function bodies are only brace matched by the pre-parse (Parser in lazy
+// mode) and parsed and checked when the function is first called, see
+// Checker::complete(). Errors in a body are reported at that point, before
+// any of it runs, and the call fails with a runtime error.
+
+// What the skipped bodies of one program need later. Lives in the arena of
+// the program.
+class LazyUnit {
+  public:
+    std::shared_ptr<const Source> source;
+    // literals of the bodies join the program's pool
+    std::shared_ptr<Types::Constants> constants;
+    // nodes of the bodies
+    Arena *arena;
+    // declared the functions and checks their bodies against its globals
+    Checker *checker = nullptr;
+    // the functions with skipped bodies, in source order
+    std::vector<FunctionStmt *> functions;
+    // guards constants while bodies are parsed in parallel
+    std::mutex lock;
+
+    LazyUnit(std::shared_ptr<const Source> source,
+             std::shared_ptr<Types::Constants> constants, Arena *arena)
+        : source(std::move(source)), constants(std::move(constants)),
+          arena(arena) {}
+};
+
+// Source of a skipped body: from just after its '{' to just after the
+// matching '}'.
+class LazyBody {
+  public:
+    LazyUnit *unit;
+    int begin;
+    int end;
+    // line of the '{'
+    int line;
+};
+
+} // namespace lox
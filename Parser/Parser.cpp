@@ -1,3 +1,4 @@
+#include <array>
 #include <cmath>
 #include <iostream>
 
@@ -15,87 +16,68 @@ extern bool hadError;
 // |   Public methods   |
 // ======================
 
-auto Parser::parse() -> std::vector<Stmt *> {
-    std::vector<Stmt *> statements;
-
+auto Parser::parse() -> Program {
     while (!isAtEnd()) {
         auto decl = declaration();
         if (decl)
-            statements.push_back(decl);
+            program.statements.push_back(decl);
     }
 
-    return statements;
+    return std::move(program);
+}
+
+auto Parser::body(Arena &arena) -> std::vector<Stmt *> {
+    this->arena = &arena;
+    FunctionScope scope(this);
+    try {
+        return block();
+    } catch (const ParseError &) {
+        return {};
+    }
 }
 
 // ======================
 // |   Service methods  |
 // ======================
 
-auto Parser::push(Token token) -> void { stack.push(token); }
-auto Parser::isAtEnd() -> bool { return peek().type() == LOX_EOF; }
-auto Parser::peek() -> Token& { return tokens[current]; }
-auto Parser::previous() -> Token& {
+auto Parser::isAtEnd() -> bool { return scanner.type(current) == LOX_EOF; }
+// tokens are pulled from the scanner and materialized only when they are kept
+auto Parser::peek() -> Token { return scanner.token(current); }
+auto Parser::previous() -> Token {
     if (current - 1 < 0)
         throw error(peek(), "");
-    return tokens[current - 1];
+    return scanner.token(current - 1);
 }
-auto Parser::top() -> Token& { return stack.top(); }
-auto Parser::matchMemory(TokenType memory) -> bool {
-    if (stack.empty())
+// LOX_EOF is never part of a set, so there is no end check
+auto Parser::match(TokenSet types) -> bool {
+    if (!types.contains(scanner.type(current)))
         return false;
-    if (!checkMemory(memory))
-        return false;
-    stack.pop();
+    advance();
     return true;
 }
-auto Parser::checkMemory(TokenType memory) -> bool {
-    if (stack.empty())
-        return false;
-    return stack.top().type() == memory;
-}
-auto Parser::match(std::vector<TokenType> &&types) -> bool {
-    for (auto type : types)
-        if (check(type)) {
-            advance();
-            return true;
-        }
-    return false;
-}
-auto Parser::match(std::vector<TokenType> &&types, TokenType memory) -> bool {
-    for (auto type : types)
-        if (check(type, memory)) {
-            advance();
-            stack.pop();
-            return true;
-        }
-
-    return false;
-}
 auto Parser::check(TokenType type) -> bool {
     if (isAtEnd())
         return false;
-    return peek().type() == type;
-}
-auto Parser::check(TokenType type, TokenType memory) -> bool {
-    if (isAtEnd() or stack.empty())
-        return false;
-    return peek().type() == type and stack.top().type() == memory;
+    return scanner.type(current) == type;
 }
-auto Parser::advance() -> Token {
+auto Parser::advance() -> void {
     if (!isAtEnd())
         ++current;
-    return previous();
+    // nothing looks further back than previous()
+    scanner.release(current - 1);
 }
 auto Parser::consume(TokenType type, std::string &&msg) -> Token {
-    if (check(type))
-        return advance();
+    if (check(type)) {
+        advance();
+        return previous();
+    }
     throw error(peek(), std::move(msg));
 }
 auto Parser::error(Token token, std::string &&msg) -> ParseError {
     if (token.type() == LOX_EOF)
         report(token.line(), "Parser", "at end. " + msg);
     else
-        report(token.line(), "Parser", "at '" + token.lexeme() + "'. " + msg);
+        report(token.line(), "Parser", "at '" + std::string(token.lexeme()) + "'. " + msg);
 
     throw ParseError("Parse error occured!");
 }
@@ -103,10 +85,10 @@ auto Parser::synchronize() -> void {
     advance();
 
     while (!isAtEnd()) {
-        if (previous().type() == SEMICOLON)
+        if (scanner.type(current - 1) == SEMICOLON)
             return;
 
-        switch (peek().type()) {
+        switch (scanner.type(current)) {
         case FUN:
         case VAR:
         case FOR:
@@ -123,11 +105,39 @@ auto Parser::synchronize() -> void {
         advance();
     }
 }
-auto Parser::pop() -> Token {
-    auto token = stack.top();
-    stack.pop();
-    return token;
-}
+namespace {
+
+struct Rule {
+    Parser::Precedence precedence = Parser::NONE;
+    // precedence the right operand is parsed with
+    Parser::Precedence operand = Parser::NONE;
+    bool logical = false;
+};
+
+constexpr auto rules = [] {
+    std::array<Rule, LOX_EOF + 1> table{};
+    auto level = [&](Parser::Precedence precedence, TokenSet types) {
+        for (int type = 0; type <= LOX_EOF; ++type)
+            if (types.contains(TokenType(type)))
+                table[type] = {precedence, Parser::Precedence(precedence + 1)};
+    };
+    level(Parser::OR, {OR});
+    level(Parser::AND, {AND});
+    level(Parser::EQUALITY, {BANG_EQUAL, EQUAL_EQUAL});
+    level(Parser::COMPARISON, {GREATER, GREATER_EQUAL, LESS, LESS_EQUAL});
+    level(Parser::SHIFT, {SHIFT_LEFT, SHIFT_RIGHT});
+    level(Parser::TERM, {MINUS, PLUS});
+    level(Parser::FACTOR, {SLASH, STAR});
+
+    table[OR].logical = table[AND].logical = true;
+    // the right operand of a comparison has always been a term, so
+    // "a < b << c" is rejected rather than read as "a < (b << c)"
+    for (auto type : {GREATER, GREATER_EQUAL, LESS, LESS_EQUAL})
+        table[type].operand = Parser::TERM;
+    return table;
+}();
+
+} // namespace
 
 // ======================
 // |       RULES        |
@@ -138,104 +148,47 @@ auto Parser::expression() -> Expr * {
     return assignment();
 }
 auto Parser::assignment() -> Expr * {
-    auto expr = logic_or();
+    auto expr = binary(Parser::OR);
 
-    if (check(EQUAL) and checkMemory(IDENTIFIER)) {
-        advance();
-        auto val = pop();
+    if (match({EQUAL})) {
+        if (!target)
+            error(previous(), "Invalid assignment target.");
+        Token name = target->name;
+        target = nullptr;
         auto value = assignment();
-        return new AssignExpr(val, value);
-
-    } else if (match({EQUAL}))
-        error(previous(), "Invalid assignment target.");
-    matchMemory(IDENTIFIER);
-
-    return expr;
-}
-auto Parser::logic_or() -> Expr * {
-    auto expr = logic_and();
-
-    while (match({OR})) {
-        Token op = previous();
-        auto right = logic_and();
-
-        expr = new LogicalExpr(expr, op, right);
-    }
-
-    return expr;
-}
-auto Parser::logic_and() -> Expr * {
-    auto expr = equality();
-
-    while (match({AND})) {
-        Token op = previous();
-        auto right = equality();
-
-        expr = new LogicalExpr(expr, op, right);
+        return make<AssignExpr>(name, value);
     }
+    target = nullptr;
 
     return expr;
 }
-auto Parser::equality() -> Expr * {
-    Expr *expr = comparison();
-
-    while (match({BANG_EQUAL, EQUAL_EQUAL})) {
-        Token op = previous();
-        Expr *right = comparison();
-        expr = new BinaryExpr(expr, op, right);
-    }
-
-    return expr;
-}
-auto Parser::comparison() -> Expr * {
-    Expr *expr = shift();
-
-    while (match({GREATER, GREATER_EQUAL, LESS, LESS_EQUAL})) {
-        Token op = previous();
-        Expr *right = term();
-        expr = new BinaryExpr(expr, op, right);
-    }
-
-    return expr;
-}
-auto Parser::shift() -> Expr * {
-    Expr *expr = term();
-
-    while (match({SHIFT_LEFT, SHIFT_RIGHT})) {
-        Token op = previous();
-        Expr *right = term();
-        expr = new BinaryExpr(expr, op, right);
-    }
+// Operators bind at least as tight as precedence. Once an operator has been
+// applied, the loop only continues with ones that bind no tighter, which
+// keeps the comparison rule from being followed by a shift.
+auto Parser::binary(Precedence precedence) -> Expr * {
+    Expr *expr = unary();
 
-    return expr;
-}
-auto Parser::term() -> Expr * {
-    Expr *expr = factor();
+    for (auto limit = FACTOR;;) {
+        const Rule &rule = rules[scanner.type(current)];
+        if (rule.precedence < precedence or rule.precedence > limit)
+            return expr;
 
-    while (match({MINUS, PLUS})) {
+        advance();
         Token op = previous();
-        Expr *right = factor();
-        expr = new BinaryExpr(expr, op, right);
-    }
-
-    return expr;
-}
-auto Parser::factor() -> Expr * {
-    Expr *expr = unary();
+        Expr *right = binary(rule.operand);
 
-    while (match({SLASH, STAR})) {
-        Token op = previous();
-        Expr *right = unary();
-        expr = new BinaryExpr(expr, op, right);
+        if (rule.logical)
+            expr = make<LogicalExpr>(expr, op, right);
+        else
+            expr = make<BinaryExpr>(expr, op, right);
+        limit = rule.precedence;
     }
-
-    return expr;
 }
 auto Parser::unary() -> Expr * {
     if (match({BANG, MINUS})) {
         Token op = previous();
         Expr *right = unary();
-        return new UnaryExpr(op, right);
+        return make<UnaryExpr>(op, right);
     }
 
     return call();
@@ -245,7 +198,7 @@ auto Parser::call() -> Expr * {
 
     while (true) {
         if (match({LEFT_PAREN})) {
-            matchMemory(IDENTIFIER);
+            target = nullptr;
 
             expr = finishCall(expr);
 
@@ -267,29 +220,27 @@ auto Parser::finishCall(Expr *callee) -> Expr * {
 
     auto paren = consume(RIGHT_PAREN, "Expect ')' after arguments.");
 
-    return new CallExpr(callee, paren, std::move(arguments));
+    return make<CallExpr>(callee, paren, std::move(arguments));
 }
 auto Parser::primary() -> Expr * {
-    matchMemory(IDENTIFIER);
+    target = nullptr;
 
     if (match({NIL}))
-        return new LiteralExpr(Literal(nullptr));
+        return make<LiteralExpr>(Constants::NIL);
     if (match({FALSE}))
-        return new LiteralExpr(Literal(false));
+        return make<LiteralExpr>(Constants::FALSE);
     if (match({TRUE}))
-        return new LiteralExpr(Literal(true));
+        return make<LiteralExpr>(Constants::TRUE);
 
     if (match({NUMBER, STRING}))
-        return new LiteralExpr(previous().literal());
-    if (match({IDENTIFIER})) {
-        push(previous());
-        return new VariableExpr(previous());
-    }
+        return make<LiteralExpr>(scanner.literal(current - 1));
+    if (match({IDENTIFIER}))
+        return target = make<VariableExpr>(previous());
 
     if (match({LEFT_PAREN})) {
         Expr *expr = expression();
         consume(RIGHT_PAREN, "Expect ')' after expression");
-        return new GroupingExpr(expr);
+        return make<GroupingExpr>(expr);
     }
 
     throw error(peek(), "Expect expression.");
@@ -300,7 +251,7 @@ auto Parser::declaration() -> Stmt * {
         if (match({VAR}))
             return varDeclStmt();
         if (match({FUN})) {
-            LocalPush fun(this, previous());
+            FunctionScope scope(this);
             return funDeclStmt("function");
         }
         return statement();
@@ -321,7 +272,7 @@ auto Parser::statement() -> Stmt * {
         return whileStmt();
     if (match({FOR}))
         return forStmt();
-    if (check(RETURN) and checkMemory(FUN)) {
+    if (check(RETURN) and functions > 0) {
         advance();
         return returnStmt();
     } else if (match({RETURN}))
@@ -332,13 +283,13 @@ auto Parser::exprStmt() -> Stmt * {
     Expr *expr = expression();
     consume(SEMICOLON, "Expect ';' after expression.");
 
-    return new ExpressionStmt(expr);
+    return make<ExpressionStmt>(expr);
 }
 auto Parser::printStmt() -> Stmt * {
     Expr *expr = expression();
     consume(SEMICOLON, "Expect ';' after value.");
 
-    return new PrintStmt(expr);
+    return make<PrintStmt>(expr);
 }
 auto Parser::varDeclStmt() -> Stmt * {
     Token name = consume(IDENTIFIER, "Excpect variable name.");
@@ -348,7 +299,7 @@ auto Parser::varDeclStmt() -> Stmt * {
         init = expression();
 
     consume(SEMICOLON, "Expect ';' after variable declaration.");
-    return new VarStmt(name, init);
+    return make<VarStmt>(name, init);
 }
 auto Parser::block() -> std::vector<Stmt *> {
     std::vector<Stmt *> statements;
@@ -362,7 +313,7 @@ auto Parser::block() -> std::vector<Stmt *> {
     return statements;
 }
 auto Parser::blockStmt() -> Stmt * {
-    return new BlockStmt(block());
+    return make<BlockStmt>(block());
 }
 auto Parser::whileStmt() -> Stmt * {
     using namespace Types;
@@ -372,7 +323,7 @@ auto Parser::whileStmt() -> Stmt * {
 
     Stmt *body = statement();
 
-    return new WhileStmt(condition, body);
+    return make<WhileStmt>(condition, body);
 }
 auto Parser::forStmt() -> Stmt * {
     using namespace Types;
@@ -401,14 +352,15 @@ auto Parser::forStmt() -> Stmt * {
     Stmt *body = statement();
 
     if (increment)
-        body = new BlockStmt({body, new ExpressionStmt(increment)});
+        body = make<BlockStmt>(
+            std::vector<Stmt *>{body, make<ExpressionStmt>(increment)});
 
     if (!condition)
-        condition = new LiteralExpr(true);
-    body = new WhileStmt(condition, body);
+        condition = make<LiteralExpr>(Constants::TRUE);
+    body = make<WhileStmt>(condition, body);
 
     if (init)
-        body = new BlockStmt({init, body});
+        body = make<BlockStmt>(std::vector<Stmt *>{init, body});
 
     return body;
 }
@@ -424,11 +376,11 @@ auto Parser::ifStmt() -> Stmt * {
     if (match({ELSE}))
         elseBranch = statement();
 
-    return new IfStmt(condition, thenBranch, elseBranch);
+    return make<IfStmt>(condition, thenBranch, elseBranch);
 }
 auto Parser::funDeclStmt(const std::string &kind) -> Stmt * {
     Token name = consume(IDENTIFIER, "Expect " + kind + " name.");
-    consume(LEFT_PAREN, "Expect '(' after " + name.lexeme() + " name.");
+    consume(LEFT_PAREN, "Expect '(' after " + std::string(name.lexeme()) + " name.");
 
     std::vector<Token> params;
 
@@ -439,11 +391,40 @@ auto Parser::funDeclStmt(const std::string &kind) -> Stmt * {
     }
 
     consume(RIGHT_PAREN, "Expect ')' after parameters.");
-    consume(LEFT_BRACE, "Expect '{' before " + name.lexeme() + " body.");
+    consume(LEFT_BRACE, "Expect '{' before " + std::string(name.lexeme()) + " body.");
+
+    program.has_functions = true;
+    if (lazy) {
+        auto function = make<FunctionStmt>(name, params, std::vector<Stmt *>{});
+        function->lazy = skipBody();
+        function->lazy->unit->functions.push_back(function);
+        return function;
+    }
 
     auto body = block();
+    return make<FunctionStmt>(name, params, body);
+}
+// Pre-parse of a body: the tokens are only looked at for braces, the
+// statements are parsed on the first call.
+auto Parser::skipBody() -> LazyBody * {
+    Token open = previous();
+    // its literals are interned once, when the body is parsed
+    scanner.skipLiterals(true);
+    for (int depth = 1; !isAtEnd(); advance()) {
+        auto type = scanner.type(current);
+        if (type == LEFT_BRACE)
+            ++depth;
+        else if (type == RIGHT_BRACE and --depth == 0)
+            break;
+    }
+    scanner.skipLiterals(false);
+    Token close = consume(RIGHT_BRACE, "Expect '}' after block.");
 
-    return new FunctionStmt(name, params, body);
+    if (!unit)
+        program.lazy = unit =
+            arena->make<LazyUnit>(scanner.buffer(), scanner.constants(), arena);
+    return arena->make<LazyBody>(unit, open.offset() + 1, close.offset() + 1,
+                                 open.line());
 }
 auto Parser::returnStmt() -> Stmt * {
     Token keyword = previous();
@@ -453,5 +434,5 @@ auto Parser::returnStmt() -> Stmt * {
         value = expression();
 
     consume(SEMICOLON, "Expect ';' after return value.");
-    return new ReturnStmt(keyword, value);
+    return make<ReturnStmt>(keyword, value);
 }
@@ -1,36 +1,59 @@
 #pragma once
-#include <cassert>
-#include <stack>
+#include <cstdint>
+#include <initializer_list>
 #include <stdexcept>
 #include <vector>
 
+#include "../Types/Constants.h"
 #include "../Types/Token.h"
+#include "../Scanner/Scanner.h"
+#include "../Scanner/Source.h"
+#include "Arena.h"
 #include "Expr.h"
+#include "Lazy.h"
 #include "Stmt.h"
 
 namespace lox {
+
+// Result of a parse. Owns every node of the program; destroying it releases
+// the whole syntax tree at once.
+class Program {
+    std::unique_ptr<Arena> _arena = std::make_unique<Arena>();
+
+  public:
+    std::vector<Stmt *> statements;
+    // functions may be referenced from the environment after execution
+    bool has_functions = false;
+    // tokens in the tree are views into this buffer
+    std::shared_ptr<const Source> source;
+    // values of the literal expressions in the tree
+    std::shared_ptr<const Types::Constants> constants;
+    // function bodies skipped by the pre-parse, nullptr if there are none
+    LazyUnit *lazy = nullptr;
+
+    auto arena() -> Arena & { return *_arena; }
+};
+
 // ======================
 // |       RULES        |
 // ======================
 //
 // expression     → assignment ;
-// assignment     → IDENTIFIER "=" assignment | logic_or ;
-// logic_or       → logic_and ("or" logic_and)* ;
-// logic_and      → equality ("and" equality)* ;
-// equality       → comparison ( ( "!=" | "==" ) comparison )* ;
-// comparison     → shift ( ( ">" | ">=" | "<" | "<=" ) shift )* ;
-// shift          → term ( ( ">>" | "<<" ) term )* ;
-// term           → factor ( ( "-" | "+" ) factor )* ;
-// factor         → unary ( ( "/" | "*" ) unary )* ;
+// assignment     → IDENTIFIER "=" assignment | binary ;
+// binary         → unary ( OPERATOR unary )* ;
 // unary          → ( "!" | "-" ) unary | call ;
 // call           → primary ( "(" arguments? ")" )* ;
 // primary        → NUMBER | STRING | "true" | "false" | "nil"
 //                         | IDENTIFIER | "(" expression ")" ;
 //
-// binaryExpr     → 
-//
 // arguments      → expression ( "," expression )* ;
 //
+// Binary operators are parsed by precedence climbing over the table in
+// Parser.cpp, all of them are left associative:
+//
+//      "or"  <  "and"  <  "!=" "=="  <  ">" ">=" "<" "<="  <  ">>" "<<"
+//            <  "-" "+"  <  "/" "*"
+//
 // program        → declaration* EOF ;
 // declaration    → funDecl | varDecl | statement ;
 //
@@ -50,52 +73,78 @@ namespace lox {
 // exprStmt       → expression ";" ;
 // printStmt      → "print" expression ";" ;
 
+// Set of token types as a bit mask, match() tests the current token against
+// it with a single shift.
+class TokenSet {
+    uint64_t bits = 0;
+
+  public:
+    constexpr TokenSet(std::initializer_list<Types::TokenType> types) {
+        for (auto type : types)
+            bits |= uint64_t(1) << type;
+    }
+
+    constexpr auto contains(Types::TokenType type) const -> bool {
+        return bits >> type & 1;
+    }
+};
+
 class Parser {
+  public:
+    // binding power of the binary operators, NONE for every other token
+    enum Precedence : uint8_t {
+        NONE, OR, AND, EQUALITY, COMPARISON, SHIFT, TERM, FACTOR
+    };
+
   private:
     class ParseError : public std::runtime_error {
       public:
         explicit ParseError(const std::string &msg) : std::runtime_error(msg) {}
     };
 
-    class LocalPush {
-        const Types::Token token;
+    // counts the function bodies being parsed, return is only valid inside one
+    class FunctionScope {
         Parser *parser;
 
       public:
-        LocalPush(Parser *parser, const Types::Token token)
-            : token(token), parser(parser) {
-            parser->push(token);
-        }
-
-        ~LocalPush() { assert(parser->pop() == token); }
+        FunctionScope(Parser *parser) : parser(parser) { ++parser->functions; }
+        ~FunctionScope() { --parser->functions; }
     };
 
-    std::vector<Types::Token> &tokens;
-    std::stack<Types::Token> stack;
+    Scanner &scanner;
+    Program program;
+    // where nodes are made, the program's arena unless parsing a body
+    Arena *arena = &program.arena();
 
     int current = 0;
+    int functions = 0;
+    // pre-parse: function bodies are only brace matched
+    bool lazy = false;
+    LazyUnit *unit = nullptr;
+    // the variable a following "=" assigns to: the last primary when it
+    // was a bare name and no call or assignment has consumed it since
+    VariableExpr *target = nullptr;
 
   public:
-    Parser(std::vector<Types::Token>& tokens) : tokens(tokens) { }
+    Parser(Scanner& scanner, bool lazy = false) : scanner(scanner), lazy(lazy) { }
 
-    auto parse() -> std::vector<Stmt *>;
+    auto parse() -> Program;
+    // Parses a function body skipped by the pre-parse, from a scanner over
+    // its source (see LazyBody), into arena.
+    auto body(Arena &arena) -> std::vector<Stmt *>;
 
   private:
+    template <class Node, class... Args> auto make(Args &&...args) -> Node * {
+        return Node::create(*arena, std::forward<Args>(args)...);
+    }
+
     // Service methods
-    auto match(std::vector<Types::TokenType> &&types) -> bool;
-    auto match(std::vector<Types::TokenType> &&types, Types::TokenType memory)
-        -> bool;
-    auto matchMemory(Types::TokenType memory) -> bool;
+    auto match(TokenSet types) -> bool;
     auto check(Types::TokenType type) -> bool;
-    auto check(Types::TokenType type, Types::TokenType memory) -> bool;
-    auto checkMemory(Types::TokenType memory) -> bool;
-    auto advance() -> Types::Token;
+    auto advance() -> void;
     auto isAtEnd() -> bool;
-    auto peek() -> Types::Token&;
-    auto previous() -> Types::Token&;
-    auto push(Types::Token token) -> void;
-    auto pop() -> Types::Token;
-    auto top() -> Types::Token&;
+    auto peek() -> Types::Token;
+    auto previous() -> Types::Token;
 
     // error handling
     auto consume(Types::TokenType type, std::string &&msg) -> Types::Token;
@@ -105,13 +154,7 @@ class Parser {
     // Rules
     auto expression() -> Expr *;
     auto assignment() -> Expr *;
-    auto logic_or() -> Expr *;
-    auto logic_and() -> Expr *;
-    auto equality() -> Expr *;
-    auto comparison() -> Expr *;
-    auto shift() -> Expr *;
-    auto term() -> Expr *;
-    auto factor() -> Expr *;
+    auto binary(Precedence precedence) -> Expr *;
     auto unary() -> Expr *;
     auto call() -> Expr *;
     auto primary() -> Expr *;
@@ -128,6 +171,7 @@ class Parser {
     auto forStmt() -> Stmt *;
     auto ifStmt() -> Stmt *;
     auto funDeclStmt(const std::string& kind) -> Stmt *;
+    auto skipBody() -> LazyBody *;
     auto returnStmt() -> Stmt *;
 
     auto block() -> std::vector<Stmt *>;
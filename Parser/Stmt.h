@@ -1,10 +1,17 @@
 // This file was generated by GenerateAst
 #pragma once
+#include <cstdint>
+#include <utility>
+#include <vector>
+
 #include "../Types/Token.h"
+#include "Arena.h"
 #include "Expr.h"
+#include "Lazy.h"
 
 using namespace lox;
 
+class Stmt;
 class ExpressionStmt;
 class PrintStmt;
 class VarStmt;
@@ -14,123 +21,197 @@ class WhileStmt;
 class FunctionStmt;
 class ReturnStmt;
 
+enum class StmtKind : uint8_t {
+    EXPRESSION,
+    PRINT,
+    VAR,
+    BLOCK,
+    IF,
+    WHILE,
+    FUNCTION,
+    RETURN,
+};
+
 class StmtVisitor {
 public:
-	virtual ~StmtVisitor() = default;
-	virtual void visit(ExpressionStmt* stmt) = 0;
-	virtual void visit(PrintStmt* stmt) = 0;
-	virtual void visit(VarStmt* stmt) = 0;
-	virtual void visit(BlockStmt* stmt) = 0;
-	virtual void visit(IfStmt* stmt) = 0;
-	virtual void visit(WhileStmt* stmt) = 0;
-	virtual void visit(FunctionStmt* stmt) = 0;
-	virtual void visit(ReturnStmt* stmt) = 0;
+    virtual ~StmtVisitor() = default;
+    virtual void visit(ExpressionStmt* stmt) = 0;
+    virtual void visit(PrintStmt* stmt) = 0;
+    virtual void visit(VarStmt* stmt) = 0;
+    virtual void visit(BlockStmt* stmt) = 0;
+    virtual void visit(IfStmt* stmt) = 0;
+    virtual void visit(WhileStmt* stmt) = 0;
+    virtual void visit(FunctionStmt* stmt) = 0;
+    virtual void visit(ReturnStmt* stmt) = 0;
 };
+
+// Visitor without virtual calls: dispatchStmt() switches on the kind
+// and calls Derived::visit directly, where it can be inlined.
+template <class Derived>
+class StmtStaticVisitor {
+public:
+    void dispatchStmt(Stmt* stmt);
+};
+
 class Stmt {
 public:
-	virtual ~Stmt() = default;
-	virtual void accept(StmtVisitor* visitor) = 0;
+    const StmtKind kind;
+
+    virtual void accept(StmtVisitor* visitor) = 0;
+
+protected:
+    Stmt(StmtKind kind) : kind(kind) { }
+    // nodes are owned by an Arena and never deleted through the base,
+    // so the ones without heap members need no finalizer
+    ~Stmt() = default;
+};
+
+class ExpressionStmt : public Stmt {
+public:
+    Expr* expr;
+
+    ExpressionStmt(Expr* expr) :
+        Stmt(StmtKind::EXPRESSION), expr(expr)
+    { }
+    static ExpressionStmt* create(Arena& arena, Expr* expr) {
+        return arena.make<ExpressionStmt>(expr);
+    }
+    void accept(StmtVisitor* visitor) override {
+        visitor->visit(this);
+    };
 };
 
-class FunctionStmt : public Stmt {
+class PrintStmt : public Stmt {
 public:
-    Types::Token name;
-    std::vector<Types::Token> params;
-    std::vector<Stmt*> body;
+    Expr* expr;
+
+    PrintStmt(Expr* expr) :
+        Stmt(StmtKind::PRINT), expr(expr)
+    { }
+    static PrintStmt* create(Arena& arena, Expr* expr) {
+        return arena.make<PrintStmt>(expr);
+    }
+    void accept(StmtVisitor* visitor) override {
+        visitor->visit(this);
+    };
+};
 
-	FunctionStmt(Types::Token name, std::vector<Types::Token> params, std::vector<Stmt*> body) :
-        name(name), params(params), body(body)
-	{ }
-	void accept(StmtVisitor* visitor) override {
-		visitor->visit(this);
-	};
+class VarStmt : public Stmt {
+public:
+    Types::Token name;
+    Expr* init;
+    // local slot assigned by Checker, -1 for globals
+    int slot = -1;
+
+    VarStmt(Types::Token name, Expr* init) :
+        Stmt(StmtKind::VAR), name(name), init(init)
+    { }
+    static VarStmt* create(Arena& arena, Types::Token name, Expr* init) {
+        return arena.make<VarStmt>(name, init);
+    }
+    void accept(StmtVisitor* visitor) override {
+        visitor->visit(this);
+    };
 };
 
 class BlockStmt : public Stmt {
 public:
     std::vector<Stmt*> statements;
-
-	BlockStmt(std::vector<Stmt*> statements) :
-		statements(statements)
-	{ }
-	void accept(StmtVisitor* visitor) override {
-		visitor->visit(this);
-	};
+    // slots of the block, set by Checker; -1 runs it in a heap Environment
+    int frame = -1;
+
+    BlockStmt(std::vector<Stmt*> statements) :
+        Stmt(StmtKind::BLOCK), statements(std::move(statements))
+    { }
+    static BlockStmt* create(Arena& arena, std::vector<Stmt*> statements) {
+        return arena.make<BlockStmt>(std::move(statements));
+    }
+    void accept(StmtVisitor* visitor) override {
+        visitor->visit(this);
+    };
 };
 
 class IfStmt : public Stmt {
 public:
-	Expr* condition;
+    Expr* condition;
     Stmt* thenBranch;
     Stmt* elseBranch;
 
-	IfStmt(Expr* condition, Stmt* thenBranch, Stmt* elseBranch) :
-        condition(condition), thenBranch(thenBranch), elseBranch(elseBranch)
-	{ }
-	void accept(StmtVisitor* visitor) override {
-		visitor->visit(this);
-	};
+    IfStmt(Expr* condition, Stmt* thenBranch, Stmt* elseBranch) :
+        Stmt(StmtKind::IF), condition(condition), thenBranch(thenBranch), elseBranch(elseBranch)
+    { }
+    static IfStmt* create(Arena& arena, Expr* condition, Stmt* thenBranch, Stmt* elseBranch) {
+        return arena.make<IfStmt>(condition, thenBranch, elseBranch);
+    }
+    void accept(StmtVisitor* visitor) override {
+        visitor->visit(this);
+    };
 };
 
 class WhileStmt : public Stmt {
 public:
-	Expr* condition;
+    Expr* condition;
     Stmt* body;
 
-	WhileStmt(Expr* condition, Stmt* body) :
-        condition(condition), body(body)
-	{ }
-	void accept(StmtVisitor* visitor) override {
-		visitor->visit(this);
-	};
-};
-
-class ExpressionStmt : public Stmt {
-public:
-	Expr* expr;
-
-	ExpressionStmt(Expr* expr) :
-		expr(expr)
-	{ }
-	void accept(StmtVisitor* visitor) override {
-		visitor->visit(this);
-	};
+    WhileStmt(Expr* condition, Stmt* body) :
+        Stmt(StmtKind::WHILE), condition(condition), body(body)
+    { }
+    static WhileStmt* create(Arena& arena, Expr* condition, Stmt* body) {
+        return arena.make<WhileStmt>(condition, body);
+    }
+    void accept(StmtVisitor* visitor) override {
+        visitor->visit(this);
+    };
 };
 
-class PrintStmt : public Stmt {
+class FunctionStmt : public Stmt {
 public:
-	Expr* expr;
-
-	PrintStmt(Expr* expr) :
-		expr(expr)
-	{ }
-	void accept(StmtVisitor* visitor) override {
-		visitor->visit(this);
-	};
+    Types::Token name;
+    std::vector<Types::Token> params;
+    std::vector<Stmt*> body;
+    // local slot assigned by Checker, -1 for globals
+    int slot = -1;
+    // set while the body is only brace matched, see Lazy.h
+    LazyBody* lazy = nullptr;
+
+    FunctionStmt(Types::Token name, std::vector<Types::Token> params, std::vector<Stmt*> body) :
+        Stmt(StmtKind::FUNCTION), name(name), params(std::move(params)), body(std::move(body))
+    { }
+    static FunctionStmt* create(Arena& arena, Types::Token name, std::vector<Types::Token> params, std::vector<Stmt*> body) {
+        return arena.make<FunctionStmt>(name, std::move(params), std::move(body));
+    }
+    void accept(StmtVisitor* visitor) override {
+        visitor->visit(this);
+    };
 };
 
 class ReturnStmt : public Stmt {
 public:
     Types::Token keyword;
-	Expr* expr;
-
-	ReturnStmt(Types::Token keyword, Expr* expr) :
-		keyword(keyword), expr(expr)
-	{ }
-	void accept(StmtVisitor* visitor) override {
-		visitor->visit(this);
-	};
+    Expr* expr;
+
+    ReturnStmt(Types::Token keyword, Expr* expr) :
+        Stmt(StmtKind::RETURN), keyword(keyword), expr(expr)
+    { }
+    static ReturnStmt* create(Arena& arena, Types::Token keyword, Expr* expr) {
+        return arena.make<ReturnStmt>(keyword, expr);
+    }
+    void accept(StmtVisitor* visitor) override {
+        visitor->visit(this);
+    };
 };
 
-class VarStmt : public Stmt {
-public:
-    Types::Token name;
-	Expr* init;
-
-	VarStmt(Types::Token token, Expr* expr = nullptr) :
-		name(token), init(expr)
-	{ }
-	void accept(StmtVisitor* visitor) override {
-		visitor->visit(this);
-	};
-};
+template <class Derived>
+inline void StmtStaticVisitor<Derived>::dispatchStmt(Stmt* stmt) {
+    auto self = static_cast<Derived*>(this);
+    switch (stmt->kind) {
+    case StmtKind::EXPRESSION: return self->visit(static_cast<ExpressionStmt*>(stmt));
+    case StmtKind::PRINT: return self->visit(static_cast<PrintStmt*>(stmt));
+    case StmtKind::VAR: return self->visit(static_cast<VarStmt*>(stmt));
+    case StmtKind::BLOCK: return self->visit(static_cast<BlockStmt*>(stmt));
+    case StmtKind::IF: return self->visit(static_cast<IfStmt*>(stmt));
+    case StmtKind::WHILE: return self->visit(static_cast<WhileStmt*>(stmt));
+    case StmtKind::FUNCTION: return self->visit(static_cast<FunctionStmt*>(stmt));
+    case StmtKind::RETURN: return self->visit(static_cast<ReturnStmt*>(stmt));
+    }
+}
@@ -0,0 +1,114 @@
+#pragma once
+#include <array>
+#include <bit>
+#include <cstdint>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace lox::scan {
+
+// Character classes of the lexer, one table lookup instead of the locale
+// aware <cctype> calls.
+enum Class : uint8_t {
+    BLANK = 1 << 0,  // ' ', '\t', '\r', '\n'
+    DIGIT = 1 << 1,  // 0-9
+    ALPHA = 1 << 2,  // a-z, A-Z, '_'
+    HEX   = 1 << 3,  // 0-9, a-f, A-F
+};
+
+inline constexpr std::array<uint8_t, 256> classes = [] {
+    std::array<uint8_t, 256> table{};
+    for (int ch : {' ', '\t', '\r', '\n'})
+        table[ch] |= BLANK;
+    for (int ch = '0'; ch <= '9'; ++ch)
+        table[ch] |= DIGIT | HEX;
+    for (int ch = 'a'; ch <= 'z'; ++ch)
+        table[ch] |= ALPHA, table[ch - 'a' + 'A'] |= ALPHA;
+    for (int ch = 'a'; ch <= 'f'; ++ch)
+        table[ch] |= HEX, table[ch - 'a' + 'A'] |= HEX;
+    table['_'] |= ALPHA;
+    return table;
+}();
+
+inline auto is(uint8_t mask, char ch) -> bool {
+    return classes[(unsigned char)ch] & mask;
+}
+inline auto isDigit(char ch) -> bool { return is(DIGIT, ch); }
+inline auto isAlpha(char ch) -> bool { return is(ALPHA, ch); }
+inline auto isWord(char ch) -> bool { return is(ALPHA | DIGIT, ch); }
+inline auto isHex(char ch) -> bool { return is(HEX, ch); }
+
+// Skips blanks starting at p and adds the newlines passed over to lines.
+inline auto skipBlanks(const char *p, const char *end, int &lines) -> const char * {
+#if defined(__SSE2__)
+    const __m128i space = _mm_set1_epi8(' '), tab = _mm_set1_epi8('\t'),
+                  cr = _mm_set1_epi8('\r'), lf = _mm_set1_epi8('\n');
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        __m128i newline = _mm_cmpeq_epi8(chunk, lf);
+        __m128i blank = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, space), _mm_cmpeq_epi8(chunk, tab)),
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, cr), newline));
+
+        unsigned other = ~_mm_movemask_epi8(blank) & 0xffff;
+        unsigned newlines = _mm_movemask_epi8(newline);
+        if (other == 0) {
+            lines += std::popcount(newlines);
+            p += 16;
+            continue;
+        }
+        int count = std::countr_zero(other);
+        lines += std::popcount(newlines & ((1u << count) - 1));
+        return p + count;
+    }
+#endif
+    for (; p != end and is(BLANK, *p); ++p)
+        lines += *p == '\n';
+    return p;
+}
+
+// Finds the first quote at or after p, end when there is none, and adds the
+// newlines passed over to lines.
+inline auto findQuote(const char *p, const char *end, char quote, int &lines)
+    -> const char * {
+#if defined(__SSE2__)
+    const __m128i q = _mm_set1_epi8(quote), lf = _mm_set1_epi8('\n');
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        unsigned found = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, q));
+        unsigned newlines = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, lf));
+        if (found == 0) {
+            lines += std::popcount(newlines);
+            p += 16;
+            continue;
+        }
+        int count = std::countr_zero(found);
+        lines += std::popcount(newlines & ((1u << count) - 1));
+        return p + count;
+    }
+#endif
+    for (; p != end and *p != quote; ++p)
+        lines += *p == '\n';
+    return p;
+}
+
+// Finds the end of a line comment: the newline at or after p, or end.
+inline auto findNewline(const char *p, const char *end) -> const char * {
+#if defined(__SSE2__)
+    const __m128i lf = _mm_set1_epi8('\n');
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        unsigned found = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, lf));
+        if (found != 0)
+            return p + std::countr_zero(found);
+        p += 16;
+    }
+#endif
+    for (; p != end and *p != '\n'; ++p)
+        ;
+    return p;
+}
+
+} // namespace lox::scan
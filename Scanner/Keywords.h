@@ -0,0 +1,56 @@
+#pragma once
+#include <array>
+#include <string_view>
+
+#include "../Types/Token.h"
+
+namespace lox::keywords {
+
+struct Keyword {
+    std::string_view name;
+    Types::TokenType type = Types::IDENTIFIER;
+};
+
+inline constexpr Keyword list[] = {
+    {"and", Types::AND},     {"else", Types::ELSE},     {"false", Types::FALSE},
+    {"fun", Types::FUN},     {"for", Types::FOR},       {"if", Types::IF},
+    {"nil", Types::NIL},     {"or", Types::OR},         {"print", Types::PRINT},
+    {"return", Types::RETURN}, {"true", Types::TRUE},   {"var", Types::VAR},
+    {"while", Types::WHILE},
+    // reserved, but not implemented yet
+    // {"class", Types::CLASS}, {"super", Types::SUPER}, {"this", Types::THIS},
+};
+
+inline constexpr std::size_t MIN_LENGTH = 2;
+inline constexpr std::size_t MAX_LENGTH = 6;
+
+// Perfect hash of the keywords: length plus second character is distinct
+// for every entry of list modulo 32.
+constexpr auto hash(std::string_view name) -> std::size_t {
+    return (name.size() + (unsigned char)name[1]) & 31;
+}
+
+inline constexpr auto table = [] {
+    std::array<Keyword, 32> table{};
+    for (auto &keyword : list)
+        table[hash(keyword.name)] = keyword;
+    return table;
+}();
+
+static_assert([] {
+    for (auto &keyword : list)
+        if (table[hash(keyword.name)].name != keyword.name or
+            keyword.name.size() < MIN_LENGTH or keyword.name.size() > MAX_LENGTH)
+            return false;
+    return true;
+}(), "keyword hash has a collision");
+
+// keyword type of an identifier, IDENTIFIER if it is not a keyword
+constexpr auto lookup(std::string_view name) -> Types::TokenType {
+    if (name.size() < MIN_LENGTH or name.size() > MAX_LENGTH)
+        return Types::IDENTIFIER;
+    auto &keyword = table[hash(name)];
+    return keyword.name == name ? keyword.type : Types::IDENTIFIER;
+}
+
+} // namespace lox::keywords
@@ -1,28 +1,42 @@
-#include <cctype>
+#include <algorithm>
 #include <iostream>
+#include <thread>
 #include <vector>
 
+#include "../Types/Symbols.h"
+#include "CharScan.h"
+#include "Keywords.h"
 #include "Scanner.h"
 
 using namespace lox;
 
-std::unordered_map<std::string, Types::TokenType> Scanner::keywords{
-    {"and", Types::AND},     /*{"class", Types::CLASS},*/   {"else", Types::ELSE},
-    {"false", Types::FALSE}, {"fun", Types::FUN},       {"for", Types::FOR},
-    {"if", Types::IF},       {"nil", Types::NIL},       {"or", Types::OR},
-    {"print", Types::PRINT}, {"return", Types::RETURN}, /*{"super", Types::SUPER},*/
-    /*{"this", Types::THIS},*/   {"true", Types::TRUE},     {"var", Types::VAR},
-    {"while", Types::WHILE}};
-
 void Scanner::addToken(Types::TokenType type) {
-    std::string lexeme = source.substr(start, current - start);
-    tokens.push_back({type, std::move(lexeme), line, start, current - start});
+    tokens.push(type, start, line);
 }
 
 void Scanner::addToken(Types::TokenType type, Types::Literal value) {
-    std::string lexeme = source.substr(start, current - start);
-    tokens.push_back(
-        {type, std::move(lexeme), value, line, start, current - start});
+    if (skipping) {
+        tokens.push(type, start, line);
+        return;
+    }
+    if (speculative) {
+        literals.push_back(std::move(value));
+        tokens.push(type, start, line, literals.size() - 1);
+        return;
+    }
+    if (constantsLock) {
+        std::lock_guard guard(*constantsLock);
+        tokens.push(type, start, line, _constants->add(std::move(value)));
+        return;
+    }
+    tokens.push(type, start, line, _constants->add(std::move(value)));
+}
+
+void Scanner::error(const std::string &msg) {
+    if (speculative)
+        errors.push_back({start, line, msg});
+    else
+        report(line, "Scanner", msg);
 }
 
 bool Scanner::match(char expected) {
@@ -42,55 +56,53 @@ char Scanner::peekNext() {
 }
 
 void Scanner::string() {
-    while (peek() != '"' && !isAtEnd()) {
-        if (peek() == '\n')
-            line++;
-        advance();
-    }
+    skipTo(scan::findQuote(at(current), at(source.size()), '"', line));
 
     if (isAtEnd()) {
-        report(line, "Scanner", "Unterminated string.");
+        error("Unterminated string.");
         return;
     }
 
     // The closing "
     advance();
 
+    if (skipping) {
+        addToken(Types::STRING);
+        return;
+    }
+
     // Trim the quotes
-    std::string value = source.substr(start + 1, current - start - 2);
-    addToken(Types::STRING, value);
+    std::string value(source.substr(start + 1, current - start - 2));
+    addToken(Types::STRING, std::move(value));
 }
 
 void Scanner::number() {
-    while (std::isdigit(peek()))
+    while (scan::isDigit(peek()))
         advance();
 
-    if (peek() == '.' && std::isdigit(peekNext())) {
+    if (peek() == '.' && scan::isDigit(peekNext())) {
         advance();
-        while (std::isdigit(peek()))
+        while (scan::isDigit(peek()))
             advance();
 
-        Types::Number value = std::stod(source.substr(start, current - start));
+        double value = std::stod(std::string(source.substr(start, current - start)));
         addToken(Types::NUMBER, value);
         return;
     }
 
-    Types::Number value = std::stoi(source.substr(start, current - start));
+    int value = std::stoi(std::string(source.substr(start, current - start)));
     addToken(Types::NUMBER, value);
 }
 
 auto Scanner::integer_format() -> void {
     size_t store{};
-    Types::Number value = (int) 0;
-    if (peek() == 'x' and
-        (std::isdigit(peekNext()) or
-         ('a' <= tolower(peekNext()) and tolower(peekNext()) <= 'f'))) {
+    Types::Literal value = (int) 0;
+    if (peek() == 'x' and scan::isHex(peekNext())) {
         advance();
-        while (std::isdigit(peek()) or
-               ('a' <= tolower(peek()) and tolower(peek()) <= 'f'))
+        while (scan::isHex(peek()))
             advance();
 
-        value = std::stoi(source.substr(start, current - start), &store, 16);
+        value = std::stoi(std::string(source.substr(start, current - start)), &store, 16);
     } else if (peek() == 'b' and (peekNext() == '0' or peekNext() == '1')) {
         advance();
 
@@ -99,9 +111,9 @@ auto Scanner::integer_format() -> void {
             advance(), count++;
 
         if (count > 8)
-            report(line, "Scanner", "Max 8 bits, got " + std::to_string(count));
+            error("Max 8 bits, got " + std::to_string(count));
 
-        value = (uint8_t) std::stoi(source.substr(start, current - start), &store, 2);
+        value = (uint8_t) std::stoi(std::string(source.substr(start, current - start)), &store, 2);
     } else if (peek() == '.') {
         number();
         return;
@@ -111,15 +123,22 @@ auto Scanner::integer_format() -> void {
 }
 
 void Scanner::identifier() {
-    while (std::isalnum(peek()) or peek() == '_')
+    while (scan::isWord(peek()))
         advance();
 
-    auto type = keywords.find(source.substr(start, current - start));
-    if (type != keywords.end()) {
-        addToken(type->second);
+    auto name = source.substr(start, current - start);
+    auto type = keywords::lookup(name);
+    if (type != Types::IDENTIFIER) {
+        addToken(type);
         return;
     }
-    addToken(Types::IDENTIFIER);
+
+    if (speculative) {
+        names.push_back(name);
+        tokens.push(Types::IDENTIFIER, start, line, names.size() - 1);
+        return;
+    }
+    tokens.push(Types::IDENTIFIER, start, line, Types::Symbols::intern(name));
 }
 
 void Scanner::character() {
@@ -130,18 +149,18 @@ void Scanner::character() {
     }
 
     if (isAtEnd()) {
-        report(line, "Scanner", "Unterminated single quotes.");
+        error("Unterminated single quotes.");
         return;
     }
 
     // closing '
     advance();
     if (current - start - 2 != 1) {
-        report(line, "Scanner", "Wrong size of char.");
+        error("Wrong size of char.");
         return;
     }
 
-    char value = source.substr(start + 1, current - start - 2)[0];
+    char value = source[start + 1];
     addToken(Types::STRING, value);
 }
 
@@ -173,8 +192,7 @@ void Scanner::scanToken() {
     // division or comments
     case '/':
         if (match('/'))
-            while (peek() != '\n' && !isAtEnd())
-                advance();
+            skipTo(scan::findNewline(at(current), at(source.size())));
         else if (match('*'))
             while (peek() != '*' && peekNext() != '/' && !isAtEnd()) {
                 if (peek() == '\n') ++line;
@@ -184,12 +202,12 @@ void Scanner::scanToken() {
             addToken(SLASH);
         break;
 
-    // skip white spaces
+    // skip white spaces, the whole run at once
     case '\n':
-        ++line;
     case ' ':
     case '\r':
     case '\t':
+        skipTo(scan::skipBlanks(at(start), at(source.size()), line));
         break;
 
     // string literal
@@ -207,24 +225,160 @@ void Scanner::scanToken() {
 
     default:
         // number literal
-        if (std::isdigit(ch))
+        if (scan::isDigit(ch))
             number();
         // identifier
-        else if (std::isalpha(ch) or ch == '_')
+        else if (scan::isAlpha(ch))
             identifier();
         else
-            report(line, "Scanner",
-                   "Unexpected character '" + std::string(1, ch) + "'.");
+            error("Unexpected character '" + std::string(1, ch) + "'.");
     }
 }
 
-std::vector<Types::Token>&& Scanner::scanTokens() {
-    while (!isAtEnd()) {
+// scans until at least one more token is in the buffer
+auto Scanner::scanNext() -> void {
+    int count = tokens.end();
+    while (tokens.end() == count) {
+        if (isAtEnd()) {
+            tokens.push(Types::LOX_EOF, source.size(), line);
+            finished = true;
+            return;
+        }
         start = current;
         scanToken();
     }
+}
+
+auto Scanner::scanTokens(int jobs) -> const TokenBuffer & {
+    if (jobs > 1 and current == 0 and tokens.end() == 0)
+        scanParallel(jobs);
 
-    tokens.push_back({Types::LOX_EOF, "", line, start, 0});
+    while (not finished)
+        scanNext();
+    return tokens;
+}
+
+// Scans the tokens that start before end and returns where the next chunk
+// continues: the start of the first token at or after end. Whatever starts
+// before that (including a string or comment running past end) is ours.
+auto Scanner::scanChunk(int end) -> int {
+    while (not isAtEnd()) {
+        start = current;
+        int count = tokens.end();
+        scanToken();
+
+        if (start >= end and tokens.end() != count) {
+            tokens.pop();
+            while (not errors.empty() and errors.back().offset >= start)
+                errors.pop_back();
+            return start;
+        }
+    }
+    return source.size();
+}
+
+// Every chunk is scanned speculatively, as if a token started right at its
+// first byte, with lines counted from zero. The chunks are then merged in
+// order. A chunk is taken over from the first of its tokens that starts
+// exactly where the previous chunk stopped, since from a token start on
+// scanning depends on nothing but the position. If there is no such token
+// (the boundary was inside a string, char or comment that swallowed the
+// whole chunk), the chunk is scanned again from the right position.
+//
+// The line of a position is one plus the newlines before it, so relative
+// lines are fixed up with a prefix count of newlines.
+auto Scanner::scanParallel(int jobs) -> void {
+    size_t chunkSize = std::max(PARALLEL_MIN_CHUNK, source.size() / jobs + 1);
+    int count = (source.size() + chunkSize - 1) / chunkSize;
+    if (count < 2)
+        return;
+
+    struct Chunk {
+        int begin, end;
+        int newlines;   // in [begin, end)
+        int next;       // position the following chunk continues from
+        std::unique_ptr<Scanner> scanner;
+    };
+
+    std::vector<Chunk> chunks(count);
+    auto scan = [this](Chunk &chunk) {
+        auto text = source.substr(chunk.begin, chunk.end - chunk.begin);
+        chunk.newlines = std::count(text.begin(), text.end(), '\n');
+
+        chunk.scanner = std::make_unique<Scanner>(_buffer);
+        chunk.scanner->speculative = true;
+        chunk.scanner->current = chunk.begin;
+        chunk.scanner->line = 0;
+        try {
+            chunk.next = chunk.scanner->scanChunk(chunk.end);
+        } catch (std::exception &) {
+            // a speculative start may misread the text, the chunk is
+            // scanned again on this thread when it is merged
+            chunk.scanner.reset();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < count; ++i) {
+        chunks[i].begin = i * chunkSize;
+        chunks[i].end = std::min(source.size(), (i + 1) * chunkSize);
+        if (i > 0)
+            workers.emplace_back(scan, std::ref(chunks[i]));
+    }
+    scan(chunks[0]);
+    for (auto &worker : workers)
+        worker.join();
+
+    auto newlinesBefore = [&](int i, int position) {
+        int lines = 0;
+        for (int j = 0; j < i; ++j)
+            lines += chunks[j].newlines;
+        auto text = source.substr(chunks[i].begin, position - chunks[i].begin);
+        return lines + (int)std::count(text.begin(), text.end(), '\n');
+    };
+
+    // copies the tokens and errors of scanner at or after position
+    auto merge = [this](Scanner &scanner, int position, int lines) {
+        // literals and names are interned in token order, as a single scan
+        // would do
+        tokens.append(scanner.tokens, scanner.tokens.find(position), lines,
+                      [&](Types::TokenType type, int value) {
+                          if (type == Types::IDENTIFIER)
+                              return Types::Symbols::intern(scanner.names[value]);
+                          return _constants->add(std::move(scanner.literals[value]));
+                      });
+
+        for (auto &error : scanner.errors)
+            if (error.offset >= position)
+                report(error.line + lines, "Scanner", error.msg);
+    };
+
+    int position = 0;
+    for (int i = 0; i < count and position < (int)source.size(); ++i) {
+        auto &chunk = chunks[i];
+        bool synced = false;
+        if (chunk.scanner) {
+            auto &speculative = chunk.scanner->tokens;
+            int first = speculative.find(position);
+            synced = position == chunk.begin or
+                     (first != speculative.end() and
+                      speculative.offset(first) == position);
+        }
+
+        if (not synced) {
+            Scanner rescan(_buffer);
+            rescan.speculative = true;
+            rescan.current = position;
+            rescan.line = 0;
+            chunk.next = rescan.scanChunk(chunk.end);
+            merge(rescan, position, 1 + newlinesBefore(i, position));
+        } else {
+            merge(*chunk.scanner, position, 1 + newlinesBefore(i, chunk.begin));
+        }
+        position = std::max(chunk.next, position);
+        chunk.scanner.reset();
+    }
 
-    return std::move(tokens);
+    current = position;
+    line = 1 + newlinesBefore(count - 1, source.size());
 }
@@ -1,10 +1,15 @@
 #pragma once
 #include <istream>
-#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <string_view>
 #include <vector>
 
+#include "../Types/Constants.h"
 #include "../Types/Token.h"
 #include "../Error/Error.h"
+#include "Source.h"
+#include "TokenBuffer.h"
 
 extern bool hadError;
 
@@ -15,14 +20,38 @@ class Scanner
 {
 private:
 
-    std::string source;
-    std::vector<Types::Token> tokens;
-
-    static std::unordered_map<std::string, Types::TokenType> keywords;
+    // tokens are views into _buffer, see buffer()
+    std::shared_ptr<const Source> _buffer;
+    std::string_view source;
+    TokenBuffer tokens;
+    // literal values of the tokens, see constants()
+    std::shared_ptr<Types::Constants> _constants =
+        std::make_shared<Types::Constants>();
+    std::mutex *constantsLock = nullptr;
+    // literals of a body the lazy pre-parse skips are left out of the pool,
+    // they are interned when the body is parsed, see skipLiterals()
+    bool skipping = false;
 
     int start = 0;
     int current = 0;
     int line = 1;
+    bool finished = false;
+
+    // A chunk scanned on a worker thread is speculative: its errors are
+    // reported and its literals interned only when the chunk is merged, see
+    // scanParallel(). Token values then point into literals and names.
+    struct DeferredError {
+        int offset;
+        int line;
+        std::string msg;
+    };
+    bool speculative = false;
+    std::vector<DeferredError> errors;
+    std::vector<Types::Literal> literals;
+    std::vector<std::string_view> names;
+
+    // sources smaller than this are not worth splitting
+    static constexpr size_t PARALLEL_MIN_CHUNK = 256 * 1024;
 
     auto addToken(const Types::TokenType type) -> void;
     auto addToken(const Types::TokenType type, Types::Literal value) -> void;
@@ -32,6 +61,8 @@ private:
     auto match(char expected) -> bool;
     auto peek() -> char { if (isAtEnd()) return '\0'; return source[current]; }
     auto peekNext() -> char;
+    auto at(size_t offset) -> const char * { return source.data() + offset; }
+    auto skipTo(const char *position) -> void { current = position - source.data(); }
 
     auto string() -> void;
     auto character() -> void;
@@ -39,15 +70,61 @@ private:
     auto integer_format() -> void;
     auto identifier() -> void;
 
+    auto error(const std::string& msg) -> void;
+
     auto scanToken() -> void;
+    auto scanNext() -> void;
+    auto scanChunk(int end) -> int;
+    auto scanParallel(int jobs) -> void;
+    auto fill(int index) -> void {
+        while (index >= tokens.end() and not finished)
+            scanNext();
+    }
 
 public:
 
-    Scanner (std::string&& input):
-        source(std::move(input))
+    Scanner (std::shared_ptr<const Source> input):
+        _buffer(std::move(input)),
+        source(_buffer->text()),
+        tokens(source)
+    { }
+
+    // Scanner over [begin, end) of input, counting lines from line and
+    // adding literals to constants, under lock when it is shared between
+    // threads. Token offsets stay those of the whole input. Used for
+    // function bodies that are parsed on demand.
+    Scanner (std::shared_ptr<const Source> input, int begin, int end, int line,
+            std::shared_ptr<Types::Constants> constants,
+            std::mutex *lock = nullptr):
+        _buffer(std::move(input)),
+        source(_buffer->text().substr(0, end)),
+        tokens(source),
+        _constants(std::move(constants)),
+        constantsLock(lock),
+        current(begin),
+        line(line)
     { }
 
-    std::vector<Types::Token>&& scanTokens();
+    // Scans the rest of the source at once. Large sources are split in
+    // chunks that are scanned on up to jobs threads, with the same result.
+    auto scanTokens(int jobs = 1) -> const TokenBuffer &;
+
+    // Token cursor for the Parser. Tokens are scanned when they are first
+    // asked for and dropped after release(), so only a small window of the
+    // token stream exists at any time.
+    auto type(int index) -> Types::TokenType { fill(index); return tokens.type(index); }
+    auto literal(int index) -> int { fill(index); return tokens.literal(index); }
+    auto token(int index) -> Types::Token { fill(index); return tokens.token(index); }
+    auto release(int index) -> void { tokens.discard(index); }
+    // While set, literal tokens get no value and nothing is interned. The
+    // tokens scanned up front by scanTokens() have theirs already.
+    auto skipLiterals(bool skip) -> void { skipping = skip; }
+
+    // must be kept alive as long as the tokens (or nodes built from them)
+    auto buffer() const -> std::shared_ptr<const Source> { return _buffer; }
+    // pool the literal indices of the tokens refer to; bodies parsed on
+    // demand keep adding to it
+    auto constants() const -> std::shared_ptr<Types::Constants> { return _constants; }
 
 };
 
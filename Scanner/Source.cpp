@@ -0,0 +1,50 @@
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Source.h"
+
+using namespace lox;
+
+Source::~Source() {
+    if (mapping)
+        munmap(mapping, mapped);
+}
+
+auto Source::open(const std::string &path) -> std::shared_ptr<Source> {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+        return nullptr;
+
+    std::shared_ptr<Source> source(new Source());
+    struct stat info;
+    if (fstat(fd, &info) == 0 and S_ISREG(info.st_mode) and info.st_size > 0) {
+        void *mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping != MAP_FAILED) {
+            // the scanner walks the text front to back exactly once
+            madvise(mapping, info.st_size, MADV_SEQUENTIAL);
+            source->mapping = mapping;
+            source->mapped = info.st_size;
+            source->_text = {static_cast<const char *>(mapping), source->mapped};
+            close(fd);
+            return source;
+        }
+    }
+
+    // pipes, empty files and failed mappings are read the usual way
+    char chunk[64 * 1024];
+    for (ssize_t count; (count = read(fd, chunk, sizeof chunk)) != 0;) {
+        if (count == -1 and errno == EINTR)
+            continue;
+        if (count == -1) {
+            close(fd);
+            return nullptr;
+        }
+        source->storage.append(chunk, count);
+    }
+    source->_text = source->storage;
+    close(fd);
+    return source;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace lox {
+
+// Text of one script. Regular files are mapped into memory and lexed in
+// place, anything else (pipes, REPL input) is held in a string.
+class Source {
+    std::string storage;
+    void *mapping = nullptr;
+    std::size_t mapped = 0;
+    std::string_view _text;
+
+    Source() = default;
+
+  public:
+    Source(std::string text) : storage(std::move(text)), _text(storage) {}
+    Source(const Source &) = delete;
+    auto operator=(const Source &) -> Source & = delete;
+    ~Source();
+
+    // nullptr when the file can not be read
+    static auto open(const std::string &path) -> std::shared_ptr<Source>;
+
+    auto text() const -> std::string_view { return _text; }
+    // whether the text is a regular file mapped into memory, not a pipe,
+    // a device or REPL input
+    auto isMapped() const -> bool { return mapping != nullptr; }
+
+    // drops a single trailing newline
+    auto trim() -> void {
+        if (_text.ends_with('\n'))
+            _text.remove_suffix(1);
+    }
+};
+
+} // namespace lox
@@ -0,0 +1,99 @@
+#include <algorithm>
+
+#include "CharScan.h"
+#include "TokenBuffer.h"
+
+using namespace lox;
+using namespace lox::Types;
+
+// Rescans a single token with the rules of the Scanner. Only tokens that
+// made it into the buffer are measured, so the input is always well formed.
+auto TokenBuffer::length(int index) const -> int {
+    size_t start = offset(index);
+    size_t end = start + 1;
+
+    auto is = [&](auto predicate) {
+        return end < source.size() and predicate(source[end]);
+    };
+    auto isBinary = [](char ch) { return ch == '0' or ch == '1'; };
+    auto fraction = [&] {
+        if (end + 1 < source.size() and source[end] == '.' and
+            scan::isDigit(source[end + 1])) {
+            ++end;
+            while (is(scan::isDigit))
+                ++end;
+        }
+    };
+
+    switch (type(index)) {
+    case LOX_EOF:
+        return 0;
+
+    case BANG_EQUAL:
+    case EQUAL_EQUAL:
+    case GREATER_EQUAL:
+    case LESS_EQUAL:
+    case SHIFT_LEFT:
+    case SHIFT_RIGHT:
+        return 2;
+
+    case STRING:
+        // "string" or 'c'
+        end = source.find(source[start], start + 1) + 1;
+        break;
+
+    case NUMBER:
+        if (source[start] != '0') {
+            while (is(scan::isDigit))
+                ++end;
+            fraction();
+        } else if (source.substr(start + 1, 1) == "x") {
+            ++end;
+            while (is(scan::isHex))
+                ++end;
+        } else if (source.substr(start + 1, 1) == "b") {
+            ++end;
+            while (is(isBinary))
+                ++end;
+        } else {
+            fraction();
+        }
+        break;
+
+    default:
+        // identifiers and keywords
+        if (scan::isAlpha(source[start]))
+            while (is(scan::isWord))
+                ++end;
+    }
+    return end - start;
+}
+
+auto TokenBuffer::value(int index) const -> int {
+    auto it = std::lower_bound(values.begin(), values.end(),
+                               std::pair<uint32_t, int>{index, -1});
+    if (it == values.end() or it->first != (uint32_t)index)
+        return -1;
+    return it->second;
+}
+
+auto TokenBuffer::discard(int index) -> void {
+    int count = index - base;
+    if (count < WINDOW or count < (int)types.size() - count)
+        return;
+
+    types.erase(types.begin(), types.begin() + count);
+    offsets.erase(offsets.begin(), offsets.begin() + count);
+    lines.erase(lines.begin(), lines.begin() + count);
+    values.erase(values.begin(),
+                 std::lower_bound(values.begin(), values.end(),
+                                  std::pair<uint32_t, int>{index, -1}));
+    base = index;
+}
+
+auto TokenBuffer::token(int index) const -> Token {
+    int length = this->length(index);
+    return Token(type(index), source.substr(offset(index), length),
+                 literal(index), line(index), offset(index), length,
+                 symbol(index));
+}
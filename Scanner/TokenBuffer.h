@@ -0,0 +1,107 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "../Types/Token.h"
+
+namespace lox {
+
+// Window of the token stream of one source, as a structure of arrays.
+// Tokens keep their absolute index; the ones before begin() have been
+// discarded. Lexemes are rebuilt from the source when a token is
+// materialized with token().
+class TokenBuffer {
+    // fewest tokens dropped at once by discard(); it also waits until they
+    // are at least as many as the ones kept, so the erasing stays amortized
+    // when the whole source was scanned up front
+    static constexpr int WINDOW = 64;
+
+    std::string_view source;
+    int base = 0;
+
+    std::vector<uint8_t> types;
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> lines;
+    // (token index, value) sorted by token: the constant index of NUMBER
+    // and STRING tokens, the symbol id of IDENTIFIER tokens
+    std::vector<std::pair<uint32_t, int>> values;
+
+    auto value(int index) const -> int;
+
+  public:
+    TokenBuffer(std::string_view source) : source(source) {}
+
+    auto push(Types::TokenType type, uint32_t offset, int line) -> void {
+        types.push_back(type);
+        offsets.push_back(offset);
+        lines.push_back(line);
+    }
+    auto push(Types::TokenType type, uint32_t offset, int line, int value)
+        -> void {
+        values.push_back({(uint32_t)end(), value});
+        push(type, offset, line);
+    }
+
+    auto pop() -> void {
+        if (not values.empty() and values.back().first == (uint32_t)end() - 1)
+            values.pop_back();
+        types.pop_back();
+        offsets.pop_back();
+        lines.pop_back();
+    }
+
+    // Appends the tokens of other from index first on, moving their lines
+    // down by lines and passing their values through remap(type, value).
+    template <class Remap>
+    auto append(const TokenBuffer &other, int first, int lines, Remap remap)
+        -> void {
+        int skip = first - other.base;
+        for (auto it = std::lower_bound(other.values.begin(), other.values.end(),
+                                        std::pair<uint32_t, int>{first, -1});
+             it != other.values.end(); ++it)
+            values.push_back({end() + (it->first - first),
+                              remap(other.type(it->first), it->second)});
+
+        types.insert(types.end(), other.types.begin() + skip, other.types.end());
+        offsets.insert(offsets.end(), other.offsets.begin() + skip,
+                       other.offsets.end());
+        for (auto it = other.lines.begin() + skip; it != other.lines.end(); ++it)
+            this->lines.push_back(*it + lines);
+    }
+
+    // drops the tokens before index
+    auto discard(int index) -> void;
+
+    // index of the first token starting at or after offset
+    auto find(int offset) const -> int {
+        return base + (std::lower_bound(offsets.begin(), offsets.end(),
+                                        (uint32_t)offset) - offsets.begin());
+    }
+
+    auto begin() const -> int { return base; }
+    auto end() const -> int { return base + types.size(); }
+
+    auto type(int index) const -> Types::TokenType {
+        return Types::TokenType(types[index - base]);
+    }
+    auto offset(int index) const -> int { return offsets[index - base]; }
+    auto line(int index) const -> int { return lines[index - base]; }
+
+    auto length(int index) const -> int;
+    auto lexeme(int index) const -> std::string_view {
+        return source.substr(offset(index), length(index));
+    }
+    auto literal(int index) const -> int {
+        return type(index) == Types::IDENTIFIER ? -1 : value(index);
+    }
+    auto symbol(int index) const -> int {
+        return type(index) == Types::IDENTIFIER ? value(index) : -1;
+    }
+
+    auto token(int index) const -> Types::Token;
+};
+
+} // namespace lox
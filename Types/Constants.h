@@ -0,0 +1,38 @@
+#pragma once
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+#include "Value.h"
+
+namespace lox::Types {
+
+// Literal values of one program. The scanner interns every number, string
+// and char literal here, tokens and literal expressions refer to them by
+// index. Equal literals share one entry.
+class Constants {
+    std::vector<Value> values;
+    std::unordered_map<Value, int> indices;
+
+  public:
+    // keyword literals are present in every pool
+    enum Fixed : int { NIL, FALSE, TRUE };
+
+    Constants() {
+        add(nullptr);
+        add(false);
+        add(true);
+    }
+
+    auto add(Value value) -> int {
+        auto [it, inserted] = indices.try_emplace(value, (int)values.size());
+        if (inserted)
+            values.push_back(std::move(value));
+        return it->second;
+    }
+
+    auto operator[](int index) const -> const Value & { return values[index]; }
+    auto size() const -> std::size_t { return values.size(); }
+};
+
+} // namespace lox::Types
@@ -0,0 +1,48 @@
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "Symbols.h"
+
+using namespace lox::Types;
+
+namespace {
+
+struct Table {
+    std::mutex mutex;
+    // a deque never moves its elements, the map keys are views into them
+    std::deque<std::string> names;
+    std::unordered_map<std::string_view, int> ids;
+};
+
+auto table() -> Table & {
+    static Table table;
+    return table;
+}
+
+} // namespace
+
+auto Symbols::intern(std::string_view name) -> int {
+    auto &symbols = table();
+    std::lock_guard lock(symbols.mutex);
+
+    if (auto it = symbols.ids.find(name); it != symbols.ids.end())
+        return it->second;
+
+    int symbol = symbols.names.size();
+    symbols.ids.emplace(symbols.names.emplace_back(name), symbol);
+    return symbol;
+}
+
+auto Symbols::name(int symbol) -> std::string_view {
+    auto &symbols = table();
+    std::lock_guard lock(symbols.mutex);
+    return symbols.names[symbol];
+}
+
+auto Symbols::count() -> int {
+    auto &symbols = table();
+    std::lock_guard lock(symbols.mutex);
+    return symbols.names.size();
+}
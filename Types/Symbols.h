@@ -0,0 +1,17 @@
+#pragma once
+#include <string_view>
+
+namespace lox::Types {
+
+// Global table of identifier names. The scanner interns every identifier
+// once and gives it a dense id; from then on names are compared, hashed and
+// indexed by id. Ids are never released, so they stay valid across REPL
+// lines. Interning is thread safe.
+class Symbols {
+  public:
+    static auto intern(std::string_view name) -> int;
+    static auto name(int symbol) -> std::string_view;
+    static auto count() -> int;
+};
+
+} // namespace lox::Types
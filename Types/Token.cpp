@@ -1,6 +1,5 @@
 #include "Token.h"
 #include <sstream>
-#include <variant>
 
 using namespace lox::Types;
 
@@ -47,13 +46,9 @@ const std::string& lox::Types::TokenTypeString(const TokenType value) {
     return lookup.find(value)->second;
 }
 
-auto lox::Types::isNil(Literal &lit) -> bool {
-    return std::holds_alternative<std::nullptr_t>(lit);
-}
-
 auto Stringify::operator()(std::nullptr_t) -> std::string { return "nil"; }
 
-auto Stringify::operator()(std::string value) -> std::string { return value; }
+auto Stringify::operator()(const std::string &value) -> std::string { return value; }
 
 auto Stringify::operator()(char value) -> std::string {
     return std::string(1, value);
@@ -73,10 +68,6 @@ auto Stringify::operator()(int value) -> std::string {
     return std::to_string(value);
 }
 
-auto Stringify::operator()(Number value) -> std::string {
-    return std::visit(*this, value);
-}
-
 auto Stringify::operator()(bool value) -> std::string {
     if (value)
         return "true";
@@ -93,7 +84,7 @@ auto Typify::operator()(std::nullptr_t) -> std::string {
     return "nil";
 }
 
-auto Typify::operator()(std::string value) -> std::string {
+auto Typify::operator()(const std::string &value) -> std::string {
     return "string";
 }
 
@@ -113,10 +104,6 @@ auto Typify::operator()(int value) -> std::string {
     return "integer";
 }
 
-auto Typify::operator()(Number value) -> std::string {
-    return std::visit(*this, value);
-}
-
 auto Typify::operator()(bool value) -> std::string {
     return "bool";
 }
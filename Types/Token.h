@@ -1,13 +1,14 @@
 #pragma once
-#include <boost/flyweight/flyweight.hpp>
 #include <string>
+#include <string_view>
 #include <optional>
+#include <span>
 #include <sys/types.h>
-#include <variant>
 #include <map>
 #include <vector>
 #include <cstdint>
-#include <boost/flyweight.hpp>
+
+#include "Value.h"
 
 namespace lox
 {
@@ -40,19 +41,17 @@ class Interpreter;
         LOX_EOF
     };
 
-    // priority is matter. double has hieghest priority
-    typedef std::variant<uint8_t, int, double> Number;
-    typedef std::variant<Callable*, std::string, char, Number, bool, std::nullptr_t> Literal;
+    // literals are stored in the same representation as runtime values
+    typedef Value Literal;
 
     const std::string& TokenTypeString(const TokenType value);
-    auto isNil(Literal& lit) -> bool;
 
     class Token;
     class Callable
     {
     public:
         virtual auto arity() -> int = 0;
-        virtual auto call(Interpreter* interpreter, Token& token, std::vector<Literal> arguments) -> Literal = 0;
+        virtual auto call(Interpreter* interpreter, Token& token, std::span<Value> arguments) -> Value = 0;
         virtual auto toString() -> std::string = 0;
     };
 
@@ -60,12 +59,11 @@ class Interpreter;
     {
     public:
         auto operator()(std::nullptr_t) -> std::string;
-        auto operator()(std::string value) -> std::string;
+        auto operator()(const std::string& value) -> std::string;
         auto operator()(char value) -> std::string;
         auto operator()(double value) -> std::string;
         auto operator()(int value) -> std::string;
         auto operator()(uint8_t value) -> std::string;
-        auto operator()(Number value) -> std::string;
         auto operator()(bool value) -> std::string;
         auto operator()(Callable* value) -> std::string;
     };
@@ -74,12 +72,11 @@ class Interpreter;
     {
     public:
         auto operator()(std::nullptr_t) -> std::string;
-        auto operator()(std::string value) -> std::string;
+        auto operator()(const std::string& value) -> std::string;
         auto operator()(char value) -> std::string;
         auto operator()(double value) -> std::string;
         auto operator()(int value) -> std::string;
         auto operator()(uint8_t value) -> std::string;
-        auto operator()(Number value) -> std::string;
         auto operator()(bool value) -> std::string;
         auto operator()(Callable* value) -> std::string;
     };
@@ -88,36 +85,39 @@ class Interpreter;
     {
     private:
         const TokenType _type;
-        const std::string _lexeme;
+        // points into the source buffer, which outlives the tokens
+        const std::string_view _lexeme;
 
-        //OptionalLiteral _literal = std::nullopt;
-        //Literal _literal = nullptr;
-        boost::flyweights::flyweight<Literal> _literal;
+        // index into the program's Constants, -1 for tokens without a value
+        const int _literal = -1;
+        // id of an IDENTIFIER in Symbols, -1 for other tokens
+        const int _symbol = -1;
 
         const int _line = -1;
         const int _offset = -1;
         const int _length = -1;
     public:
 
-        Token(TokenType type, std::string lexeme, Literal literal,
-                int line, int offset, int length) :
-            _type(type), _lexeme(lexeme), _literal(literal),
+        Token(TokenType type, std::string_view lexeme, int literal,
+                int line, int offset, int length, int symbol = -1) :
+            _type(type), _lexeme(lexeme), _literal(literal), _symbol(symbol),
             _line(line), _offset(offset), _length(length)
         { }
 
-        Token(TokenType type, std::string lexeme,
+        Token(TokenType type, std::string_view lexeme,
                 int line, int offset, int length) :
-            _type(type), _lexeme(lexeme), _literal(nullptr),
+            _type(type), _lexeme(lexeme),
             _line(line), _offset(offset), _length(length)
         { }
 
-        Token(TokenType type, std::string lexeme)
-            : _type(type), _lexeme(lexeme), _literal(nullptr)
+        Token(TokenType type, std::string_view lexeme)
+            : _type(type), _lexeme(lexeme)
         { }
 
         auto type()      const { return _type; }
         auto lexeme()    const { return _lexeme; }
         auto literal()   const { return _literal; }
+        auto symbol()    const { return _symbol; }
 
         auto line()      const { return _line; }
         auto offset()    const { return _offset; }
@@ -125,9 +125,8 @@ class Interpreter;
 
         std::string toString() const
         {
-            return TokenTypeString(_type) + " " + _lexeme + " "
-                + std::visit(Stringify(), _literal.get());
-                //+ std::visit(Stringify(), _literal);
+            return TokenTypeString(_type) + " " + std::string(_lexeme) + " "
+                + std::to_string(_literal);
         }
 
         friend bool operator == (const Token& lhs, const Token& rhs) = default;
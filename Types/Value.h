@@ -0,0 +1,199 @@
+#pragma once
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+
+namespace lox::Types {
+
+class Callable;
+
+// Immutable heap string shared between values by reference counting.
+class String {
+  public:
+    std::string value;
+    uint32_t refs = 1;
+
+    String(std::string value) : value(std::move(value)) {}
+};
+
+// NaN-boxed 8 byte value.
+//
+// Doubles are stored as they are. Every other kind is encoded as a quiet NaN
+// (bits 50-62 set) whose 3 bit tag is spread over the sign bit and bits
+// 48-49. Scalars keep their payload in the low 32 bits, strings and
+// callables keep a 48 bit pointer.
+class Value {
+  public:
+    enum Kind : uint8_t {
+        DOUBLE, NIL, BOOL, INT, BYTE, CHAR, STRING, CALLABLE
+    };
+
+  private:
+    static constexpr uint64_t SIGN = 0x8000000000000000;
+    static constexpr uint64_t QNAN = 0x7ffc000000000000;
+    static constexpr uint64_t CANONICAL_NAN = 0x7ff8000000000000;
+    static constexpr uint64_t PAYLOAD = 0x0000ffffffffffff;
+
+    uint64_t bits;
+
+    static constexpr auto box(Kind kind, uint64_t payload) -> uint64_t {
+        return QNAN | ((kind & 4) ? SIGN : 0) | ((uint64_t)(kind & 3) << 48) |
+               payload;
+    }
+
+    auto string() const -> String * {
+        return reinterpret_cast<String *>(bits & PAYLOAD);
+    }
+
+    auto retain() const -> void {
+        if (isString())
+            ++string()->refs;
+    }
+    auto release() -> void {
+        if (isString() and --string()->refs == 0)
+            delete string();
+    }
+
+  public:
+    Value() : bits(box(NIL, 0)) {}
+    Value(std::nullptr_t) : bits(box(NIL, 0)) {}
+    // constrained so that pointers never silently turn into bools
+    template <std::same_as<bool> T>
+    Value(T value) : bits(box(BOOL, value)) {}
+    Value(int value) : bits(box(INT, (uint32_t)value)) {}
+    Value(uint8_t value) : bits(box(BYTE, value)) {}
+    Value(char value) : bits(box(CHAR, (uint8_t)value)) {}
+    Value(double value) : bits(std::bit_cast<uint64_t>(value)) {
+        if ((bits & QNAN) == QNAN)
+            bits = CANONICAL_NAN;
+    }
+    Value(Callable *value)
+        : bits(box(CALLABLE, reinterpret_cast<uint64_t>(value))) {}
+    Value(std::string value)
+        : bits(box(STRING, reinterpret_cast<uint64_t>(new String(std::move(value))))) {}
+    Value(const char *value) : Value(std::string(value)) {}
+
+    Value(const Value &other) : bits(other.bits) { retain(); }
+    Value(Value &&other) noexcept : bits(std::exchange(other.bits, box(NIL, 0))) {}
+    ~Value() { release(); }
+
+    auto operator=(const Value &other) -> Value & {
+        other.retain();
+        release();
+        bits = other.bits;
+        return *this;
+    }
+    auto operator=(Value &&other) noexcept -> Value & {
+        if (this != &other) {
+            release();
+            bits = std::exchange(other.bits, box(NIL, 0));
+        }
+        return *this;
+    }
+
+    auto kind() const -> Kind {
+        if ((bits & QNAN) != QNAN)
+            return DOUBLE;
+        return Kind(((bits >> 61) & 4) | ((bits >> 48) & 3));
+    }
+
+    auto isDouble() const -> bool { return (bits & QNAN) != QNAN; }
+    auto isNil() const -> bool { return bits == box(NIL, 0); }
+    auto isBool() const -> bool { return kind() == BOOL; }
+    auto isInt() const -> bool { return kind() == INT; }
+    auto isByte() const -> bool { return kind() == BYTE; }
+    auto isChar() const -> bool { return kind() == CHAR; }
+    auto isString() const -> bool { return kind() == STRING; }
+    auto isCallable() const -> bool { return kind() == CALLABLE; }
+    auto isNumber() const -> bool {
+        auto k = kind();
+        return k == DOUBLE or k == INT or k == BYTE;
+    }
+
+    auto asBool() const -> bool { return bits & 1; }
+    auto asInt() const -> int { return (int32_t)(uint32_t)bits; }
+    auto asByte() const -> uint8_t { return (uint8_t)bits; }
+    auto asChar() const -> char { return (char)(uint8_t)bits; }
+    auto asDouble() const -> double { return std::bit_cast<double>(bits); }
+    auto asString() const -> const std::string & { return string()->value; }
+    auto asCallable() const -> Callable * {
+        return reinterpret_cast<Callable *>(bits & PAYLOAD);
+    }
+
+    // numeric conversions, valid for any number kind
+    auto toInt() const -> int {
+        switch (kind()) {
+        case BYTE:   return asByte();
+        case DOUBLE: return (int)asDouble();
+        default:     return asInt();
+        }
+    }
+    auto toDouble() const -> double {
+        switch (kind()) {
+        case BYTE: return asByte();
+        case INT:  return asInt();
+        default:   return asDouble();
+        }
+    }
+
+    // kind both numbers are converted to before an arithmetic operation,
+    // double has the highest priority
+    static auto promote(Kind lhs, Kind rhs) -> Kind {
+        if (lhs == DOUBLE or rhs == DOUBLE)
+            return DOUBLE;
+        if (lhs == INT or rhs == INT)
+            return INT;
+        return BYTE;
+    }
+
+    friend auto operator==(const Value &lhs, const Value &rhs) -> bool {
+        auto kind = lhs.kind();
+        if (kind != rhs.kind())
+            return false;
+        if (kind == DOUBLE)
+            return lhs.asDouble() == rhs.asDouble();
+        if (kind == STRING)
+            return lhs.asString() == rhs.asString();
+        return lhs.bits == rhs.bits;
+    }
+
+    auto hash() const -> std::size_t {
+        switch (kind()) {
+        case DOUBLE: return std::hash<double>()(asDouble());
+        case STRING: return std::hash<std::string>()(asString());
+        default:     return std::hash<uint64_t>()(bits);
+        }
+    }
+    friend auto hash_value(const Value &value) -> std::size_t {
+        return value.hash();
+    }
+};
+
+static_assert(sizeof(Value) == 8);
+
+// Calls visitor with the unboxed payload of value.
+template <class Visitor>
+auto visit(Visitor &&visitor, const Value &value) -> decltype(auto) {
+    switch (value.kind()) {
+    case Value::DOUBLE:   return visitor(value.asDouble());
+    case Value::BOOL:     return visitor(value.asBool());
+    case Value::INT:      return visitor(value.asInt());
+    case Value::BYTE:     return visitor(value.asByte());
+    case Value::CHAR:     return visitor(value.asChar());
+    case Value::STRING:   return visitor(value.asString());
+    case Value::CALLABLE: return visitor(value.asCallable());
+    default:              return visitor(nullptr);
+    }
+}
+
+} // namespace lox::Types
+
+template <> struct std::hash<lox::Types::Value> {
+    auto operator()(const lox::Types::Value &value) const -> std::size_t {
+        return value.hash();
+    }
+};
@@ -0,0 +1,104 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../Types/Token.h"
+
+class FunctionStmt;
+
+namespace lox::vm {
+
+// Operands follow the opcode in the instruction stream. Wide operands
+// (constant, global, token indices and jump offsets) are 16 bit big endian,
+// local slots and argument counts are a single byte.
+enum OpCode : uint8_t {
+    OP_CONSTANT,      // [index16]
+    OP_NIL,
+    OP_TRUE,
+    OP_FALSE,
+    OP_POP,
+    OP_POPN,          // [count8]
+
+    OP_GET_LOCAL,     // [slot8]
+    OP_SET_LOCAL,     // [slot8]
+    OP_GET_GLOBAL,    // [global16]
+    OP_SET_GLOBAL,    // [global16]
+    OP_DEFINE_GLOBAL, // [global16]
+
+    // binary operators carry the operator token for error reporting
+    OP_EQUAL,         // [token16]
+    OP_NOT_EQUAL,     // [token16]
+    OP_GREATER,       // [token16]
+    OP_GREATER_EQUAL, // [token16]
+    OP_LESS,          // [token16]
+    OP_LESS_EQUAL,    // [token16]
+    OP_ADD,           // [token16]
+    OP_SUBTRACT,      // [token16]
+    OP_MULTIPLY,      // [token16]
+    OP_DIVIDE,        // [token16]
+    OP_SHIFT_LEFT,    // [token16]
+    OP_SHIFT_RIGHT,   // [token16]
+
+    OP_NOT,
+    OP_NEGATE,        // [token16]
+
+    OP_PRINT,
+    OP_JUMP,          // [offset16]
+    OP_JUMP_IF_FALSE, // [offset16]
+    OP_JUMP_IF_TRUE,  // [offset16]
+    OP_LOOP,          // [offset16]
+    OP_CALL,          // [argc8, token16]
+    OP_RETURN,
+};
+
+class Chunk {
+  public:
+    std::vector<uint8_t> code;
+    std::vector<int> lines;
+    std::vector<Types::Literal> constants;
+    // tokens referenced by instructions that may raise runtime errors
+    std::vector<Types::Token> tokens;
+
+    auto write(uint8_t byte, int line) -> void {
+        code.push_back(byte);
+        lines.push_back(line);
+    }
+
+    auto addConstant(Types::Literal value) -> int {
+        constants.push_back(std::move(value));
+        return constants.size() - 1;
+    }
+
+    auto addToken(const Types::Token &token) -> int {
+        tokens.push_back(token);
+        return tokens.size() - 1;
+    }
+};
+
+// Compiled lox function. The bytecode VM dispatches these itself, they are
+// Callable only so that they can be stored, printed and typed as values.
+class Function final : public Types::Callable {
+  public:
+    std::string name;
+    int params = 0;
+    Chunk chunk;
+    // set until the body of a function skipped by the pre-parse is
+    // compiled, on its first call
+    FunctionStmt *declaration = nullptr;
+
+    Function(std::string name, int params = 0)
+        : name(std::move(name)), params(params) {}
+
+    auto arity() -> int override { return params; }
+    auto toString() -> std::string override {
+        if (name.empty())
+            return "<script>";
+        return "<fun " + name + ">";
+    }
+
+    auto call(Interpreter *interpreter, Types::Token &token,
+              std::span<Types::Value> arguments) -> Types::Value override;
+};
+
+} // namespace lox::vm
@@ -0,0 +1,336 @@
+#include <limits>
+
+#include "../Error/Error.h"
+#include "Compiler.h"
+#include "VM.h"
+
+using namespace lox;
+using namespace lox::vm;
+using namespace Types;
+
+// ======================
+// |   Public methods   |
+// ======================
+
+auto Compiler::compile(std::vector<Stmt *> &stmts) -> Function * {
+    FunctionState script{new Function("")};
+    // slot zero holds the function being executed
+    script.locals.push_back({-1, 0});
+    current = &script;
+
+    for (auto stmt : stmts)
+        compile(stmt);
+
+    emit(OP_NIL);
+    emit(OP_RETURN);
+
+    current = nullptr;
+    return script.function;
+}
+
+// ======================
+// |   Service methods  |
+// ======================
+
+auto Compiler::compile(Stmt *stmt) -> void { stmt->accept(this); }
+auto Compiler::compile(Expr *expr) -> void { expr->accept(this); }
+auto Compiler::error(const std::string &msg) -> void {
+    report(line, "Compiler", msg);
+}
+auto Compiler::emit(uint8_t byte) -> void { chunk().write(byte, line); }
+auto Compiler::emit(OpCode op, uint8_t operand) -> void {
+    emit(op);
+    emit(operand);
+}
+auto Compiler::emitShort(uint16_t value) -> void {
+    emit((value >> 8) & 0xff);
+    emit(value & 0xff);
+}
+auto Compiler::emitConstant(Lit value) -> void {
+    int index = chunk().addConstant(std::move(value));
+    if (index > std::numeric_limits<uint16_t>::max())
+        error("Too many constants in one chunk.");
+    emit(OP_CONSTANT);
+    emitShort(index);
+}
+auto Compiler::emitLiteral(int constant) -> void {
+    // each literal of the program is added to a chunk at most once
+    auto it = current->constants.find(constant);
+    if (it == current->constants.end()) {
+        emitConstant(constants[constant]);
+        current->constants.emplace(constant, chunk().constants.size() - 1);
+        return;
+    }
+    emit(OP_CONSTANT);
+    emitShort(it->second);
+}
+auto Compiler::emitToken(const Token &token) -> void {
+    int index = chunk().addToken(token);
+    if (index > std::numeric_limits<uint16_t>::max())
+        error("Too many operators in one chunk.");
+    emitShort(index);
+}
+auto Compiler::emitJump(OpCode op) -> int {
+    emit(op);
+    emitShort(0xffff);
+    return chunk().code.size() - 2;
+}
+auto Compiler::emitLoop(int start) -> void {
+    emit(OP_LOOP);
+    int offset = chunk().code.size() - start + 2;
+    if (offset > std::numeric_limits<uint16_t>::max())
+        error("Loop body too large.");
+    emitShort(offset);
+}
+auto Compiler::patchJump(int offset) -> void {
+    // -2 to adjust for the bytecode for the jump offset itself
+    int jump = chunk().code.size() - offset - 2;
+    if (jump > std::numeric_limits<uint16_t>::max())
+        error("Too much code to jump over.");
+
+    chunk().code[offset] = (jump >> 8) & 0xff;
+    chunk().code[offset + 1] = jump & 0xff;
+}
+auto Compiler::beginScope() -> void { current->scopeDepth++; }
+auto Compiler::endScope() -> void {
+    current->scopeDepth--;
+
+    int count = 0;
+    auto &locals = current->locals;
+    while (!locals.empty() and locals.back().depth > current->scopeDepth) {
+        locals.pop_back();
+        count++;
+    }
+
+    if (count == 1)
+        emit(OP_POP);
+    else if (count > 1)
+        emit(OP_POPN, count);
+}
+auto Compiler::resolveLocal(int symbol) -> int {
+    auto &locals = current->locals;
+    for (int i = locals.size() - 1; i > 0; --i)
+        if (locals[i].symbol == symbol)
+            return i;
+    return -1;
+}
+auto Compiler::declareLocal(const Token &name) -> void {
+    if (current->locals.size() > std::numeric_limits<uint8_t>::max()) {
+        error("Too many local variables in function.");
+        return;
+    }
+    current->locals.push_back({name.symbol(), current->scopeDepth});
+}
+auto Compiler::define(const Token &name) -> void {
+    line = name.line();
+    if (current->scopeDepth > 0) {
+        // the value on top of the stack becomes the local's slot
+        declareLocal(name);
+        return;
+    }
+    emit(OP_DEFINE_GLOBAL);
+    emitShort(vm.globalSlot(name.symbol()));
+}
+
+// ======================
+// |     Statements     |
+// ======================
+
+auto Compiler::visit(ExpressionStmt *stmt) -> void {
+    compile(stmt->expr);
+    emit(OP_POP);
+}
+auto Compiler::visit(PrintStmt *stmt) -> void {
+    compile(stmt->expr);
+    emit(OP_PRINT);
+}
+auto Compiler::visit(VarStmt *stmt) -> void {
+    if (stmt->init)
+        compile(stmt->init);
+    else
+        emit(OP_NIL);
+
+    define(stmt->name);
+}
+auto Compiler::visit(BlockStmt *stmt) -> void {
+    beginScope();
+    for (auto statement : stmt->statements)
+        compile(statement);
+    endScope();
+}
+auto Compiler::visit(WhileStmt *stmt) -> void {
+    int loopStart = chunk().code.size();
+    compile(stmt->condition);
+
+    int exitJump = emitJump(OP_JUMP_IF_FALSE);
+    emit(OP_POP);
+    compile(stmt->body);
+    emitLoop(loopStart);
+
+    patchJump(exitJump);
+    emit(OP_POP);
+}
+auto Compiler::visit(IfStmt *stmt) -> void {
+    compile(stmt->condition);
+
+    int thenJump = emitJump(OP_JUMP_IF_FALSE);
+    emit(OP_POP);
+    compile(stmt->thenBranch);
+
+    int elseJump = emitJump(OP_JUMP);
+    patchJump(thenJump);
+    emit(OP_POP);
+
+    if (stmt->elseBranch)
+        compile(stmt->elseBranch);
+    patchJump(elseJump);
+}
+auto Compiler::visit(FunctionStmt *stmt) -> void {
+    line = stmt->name.line();
+    auto function = new Function(std::string(stmt->name.lexeme()),
+                                 stmt->params.size());
+    // a skipped body is compiled by the VM on the first call
+    if (stmt->lazy)
+        function->declaration = stmt;
+    else
+        compile(function, stmt);
+
+    emitConstant(function);
+    define(stmt->name);
+}
+auto Compiler::compile(Function *function, FunctionStmt *stmt) -> void {
+    line = stmt->name.line();
+    FunctionState state{function};
+    state.scopeDepth = 1;
+    state.locals.push_back({-1, 1});
+
+    auto enclosing = current;
+    current = &state;
+
+    for (auto &param : stmt->params)
+        declareLocal(param);
+    for (auto statement : stmt->body)
+        compile(statement);
+
+    emit(OP_NIL);
+    emit(OP_RETURN);
+
+    current = enclosing;
+}
+auto Compiler::visit(ReturnStmt *stmt) -> void {
+    line = stmt->keyword.line();
+    if (stmt->expr)
+        compile(stmt->expr);
+    else
+        emit(OP_NIL);
+    emit(OP_RETURN);
+}
+
+// ======================
+// |    Expressions     |
+// ======================
+
+auto Compiler::visit(BinaryExpr *expr) -> Lit {
+    compile(expr->left);
+    compile(expr->right);
+
+    line = expr->op.line();
+    switch (expr->op.type()) {
+    case EQUAL_EQUAL:   emit(OP_EQUAL); break;
+    case BANG_EQUAL:    emit(OP_NOT_EQUAL); break;
+    case GREATER:       emit(OP_GREATER); break;
+    case GREATER_EQUAL: emit(OP_GREATER_EQUAL); break;
+    case LESS:          emit(OP_LESS); break;
+    case LESS_EQUAL:    emit(OP_LESS_EQUAL); break;
+    case PLUS:          emit(OP_ADD); break;
+    case MINUS:         emit(OP_SUBTRACT); break;
+    case STAR:          emit(OP_MULTIPLY); break;
+    case SLASH:         emit(OP_DIVIDE); break;
+    case SHIFT_LEFT:    emit(OP_SHIFT_LEFT); break;
+    case SHIFT_RIGHT:   emit(OP_SHIFT_RIGHT); break;
+    default:
+        error("Unknown binary operator '" + std::string(expr->op.lexeme()) + "'.");
+        return nullptr;
+    }
+    emitToken(expr->op);
+    return nullptr;
+}
+auto Compiler::visit(LogicalExpr *expr) -> Lit {
+    compile(expr->left);
+
+    int endJump = emitJump(expr->op.type() == OR ? OP_JUMP_IF_TRUE
+                                                 : OP_JUMP_IF_FALSE);
+    emit(OP_POP);
+    compile(expr->right);
+    patchJump(endJump);
+    return nullptr;
+}
+auto Compiler::visit(GroupingExpr *expr) -> Lit {
+    compile(expr->expr);
+    return nullptr;
+}
+auto Compiler::visit(LiteralExpr *expr) -> Lit {
+    switch (expr->constant) {
+    case Constants::NIL:   emit(OP_NIL); break;
+    case Constants::FALSE: emit(OP_FALSE); break;
+    case Constants::TRUE:  emit(OP_TRUE); break;
+    default:               emitLiteral(expr->constant);
+    }
+    return nullptr;
+}
+auto Compiler::visit(UnaryExpr *expr) -> Lit {
+    compile(expr->right);
+
+    line = expr->op.line();
+    if (expr->op.type() == BANG) {
+        emit(OP_NOT);
+    } else {
+        emit(OP_NEGATE);
+        emitToken(expr->op);
+    }
+    return nullptr;
+}
+auto Compiler::visit(VariableExpr *expr) -> Lit {
+    line = expr->name.line();
+    // globals as resolved by the Checker, the Inliner moves them into
+    // callers that may have a local of the same name
+    int slot = expr->depth == -1 ? -1 : resolveLocal(expr->name.symbol());
+    if (slot != -1) {
+        emit(OP_GET_LOCAL, slot);
+    } else {
+        emit(OP_GET_GLOBAL);
+        emitShort(vm.globalSlot(expr->name.symbol()));
+    }
+    return nullptr;
+}
+auto Compiler::visit(AssignExpr *expr) -> Lit {
+    compile(expr->value);
+
+    line = expr->name.line();
+    int slot = expr->depth == -1 ? -1 : resolveLocal(expr->name.symbol());
+    if (slot != -1) {
+        emit(OP_SET_LOCAL, slot);
+    } else {
+        emit(OP_SET_GLOBAL);
+        emitShort(vm.globalSlot(expr->name.symbol()));
+    }
+    return nullptr;
+}
+auto Compiler::visit(CallExpr *expr) -> Lit {
+    if (expr->inlined) {
+        compile(expr->inlined);
+        return nullptr;
+    }
+
+    compile(expr->callee);
+    for (auto argument : expr->arguments)
+        compile(argument);
+
+    if (expr->arguments.size() > std::numeric_limits<uint8_t>::max())
+        error("Can't have more than 255 arguments.");
+
+    line = expr->paren.line();
+    emit(OP_CALL, expr->arguments.size());
+    emitToken(expr->paren);
+    return nullptr;
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include <string>
+#include <unordered_map>
+#include <string_view>
+#include <vector>
+
+#include "../Parser/Expr.h"
+#include "../Parser/Stmt.h"
+#include "../Types/Constants.h"
+#include "../Types/Token.h"
+#include "Chunk.h"
+
+namespace lox::vm {
+
+class VM;
+
+// Translates checked statements into bytecode. Names are resolved at compile
+// time: function locals (and locals of blocks at the top level) become stack
+// slots, everything else is a global slot owned by the VM. Like the
+// tree-walker, a function body sees only its own locals and globals.
+class Compiler : public ExprVisitor, public StmtVisitor {
+  private:
+    struct Local {
+        int symbol;
+        int depth;
+    };
+
+    struct FunctionState {
+        Function *function;
+        std::vector<Local> locals;
+        int scopeDepth = 0;
+        // program constant -> index in the chunk's constant table
+        std::unordered_map<int, int> constants;
+
+        explicit FunctionState(Function *function) : function(function) {}
+    };
+
+    typedef Types::Literal Lit;
+
+    VM &vm;
+    const Types::Constants &constants;
+    FunctionState *current = nullptr;
+    int line = 0;
+
+    auto chunk() -> Chunk & { return current->function->chunk; }
+
+    auto compile(Stmt *stmt) -> void;
+    auto compile(Expr *expr) -> void;
+    auto error(const std::string &msg) -> void;
+
+    auto emit(uint8_t byte) -> void;
+    auto emit(OpCode op, uint8_t operand) -> void;
+    auto emitShort(uint16_t value) -> void;
+    auto emitConstant(Lit value) -> void;
+    auto emitLiteral(int constant) -> void;
+    auto emitToken(const Types::Token &token) -> void;
+    auto emitJump(OpCode op) -> int;
+    auto emitLoop(int start) -> void;
+    auto patchJump(int offset) -> void;
+
+    auto beginScope() -> void;
+    auto endScope() -> void;
+    auto resolveLocal(int symbol) -> int;
+    auto declareLocal(const Types::Token &name) -> void;
+    auto define(const Types::Token &name) -> void;
+
+  public:
+    Compiler(VM &vm, const Types::Constants &constants)
+        : vm(vm), constants(constants) {}
+
+    auto compile(std::vector<Stmt *> &stmts) -> Function *;
+    // compiles the body of stmt into function
+    auto compile(Function *function, FunctionStmt *stmt) -> void;
+
+    // Expressions
+    auto visit(BinaryExpr *expr) -> Lit override;
+    auto visit(LogicalExpr *expr) -> Lit override;
+    auto visit(GroupingExpr *expr) -> Lit override;
+    auto visit(LiteralExpr *expr) -> Lit override;
+    auto visit(UnaryExpr *expr) -> Lit override;
+    auto visit(VariableExpr *expr) -> Lit override;
+    auto visit(AssignExpr *expr) -> Lit override;
+    auto visit(CallExpr *expr) -> Lit override;
+
+    // Statements
+    auto visit(ExpressionStmt *stmt) -> void override;
+    auto visit(PrintStmt *stmt) -> void override;
+    auto visit(VarStmt *stmt) -> void override;
+    auto visit(BlockStmt *stmt) -> void override;
+    auto visit(WhileStmt *stmt) -> void override;
+    auto visit(IfStmt *stmt) -> void override;
+    auto visit(FunctionStmt *stmt) -> void override;
+    auto visit(ReturnStmt *stmt) -> void override;
+};
+
+} // namespace lox::vm
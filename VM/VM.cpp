@@ -0,0 +1,320 @@
+#include <iostream>
+#include <typeinfo>
+
+#include "../Checker/Checker.h"
+#include "../Interpreter/Interpreter.h"
+#include "../tools/colors.h"
+#include "Compiler.h"
+#include "VM.h"
+
+using namespace lox;
+using namespace lox::vm;
+using namespace Types;
+
+extern bool hadError;
+extern bool hadRuntimeError;
+
+static void runtimeError(RuntimeError &error) {
+    std::cerr << "\e[31m";
+    std::cerr << "\n[line " << error.token.line() << "] " << "Interprete Error: "
+              << error.what() << std::endl;
+    hadRuntimeError = true;
+}
+
+auto vm::Function::call(Interpreter *, Token &token, std::span<Value>)
+    -> Value {
+    throw RuntimeError(token, "Compiled function " + toString() +
+                                  " can only be called by the VM.");
+}
+
+VM::VM() {
+    defineNative("clock", new ClockCallable());
+    defineNative("pow", new PowCallable());
+    defineNative("log2", new Log2Callable());
+    defineNative("prn", new PRNCallable());
+    defineNative("type", new TypeCallable());
+}
+
+auto VM::defineNative(const std::string &name, Callable *native) -> void {
+    int slot = globalSlot(Symbols::intern(name));
+    globals[slot] = native;
+    defined[slot] = true;
+}
+
+auto VM::globalSlot(int symbol) -> int {
+    if ((size_t)symbol >= globalSlots.size())
+        globalSlots.resize(symbol + 1, -1);
+    if (globalSlots[symbol] != -1)
+        return globalSlots[symbol];
+
+    int slot = globals.size();
+    globalSlots[symbol] = slot;
+    globalSymbols.push_back(symbol);
+    globals.push_back(nullptr);
+    defined.push_back(false);
+    return slot;
+}
+
+auto VM::compile(std::vector<Stmt *> stmts, const Constants &constants)
+    -> vm::Function * {
+    Compiler compiler(*this, constants);
+    vm::Function *script = compiler.compile(stmts);
+    return hadError ? nullptr : script;
+}
+
+auto VM::interprete(std::vector<Stmt *> stmts, const Constants &constants)
+    -> void {
+    if (vm::Function *script = compile(std::move(stmts), constants))
+        interprete(script);
+}
+
+auto VM::interprete(vm::Function *script) -> void {
+    top = stack.data();
+    *top++ = script;
+    frames[0] = {script, script->chunk.code.data(), stack.data()};
+    frameCount = 1;
+
+    try {
+        run();
+    } catch (RuntimeError &err) {
+        runtimeError(err);
+        top = stack.data();
+        frameCount = 0;
+    }
+}
+
+// Parses, checks and compiles the body of a function skipped by the
+// pre-parse, on its first call.
+auto VM::finish(vm::Function *function, const Token &paren) -> void {
+    FunctionStmt *stmt = function->declaration;
+    RuntimeError error(paren, "Body of " + function->toString() + " has errors.");
+
+    // once parsed, the body is only left pending when it failed to compile
+    if (!stmt->lazy)
+        throw error;
+    auto unit = stmt->lazy->unit;
+    if (!unit->checker->complete(stmt))
+        throw error;
+
+    Compiler compiler(*this, *unit->constants);
+    compiler.compile(function, stmt);
+    if (hadError)
+        throw error;
+    function->declaration = nullptr;
+}
+
+auto VM::run() -> void {
+    CallFrame *frame = &frames[frameCount - 1];
+    const uint8_t *ip = frame->ip;
+    const Chunk *chunk = &frame->function->chunk;
+
+    auto readByte = [&ip]() -> uint8_t { return *ip++; };
+    auto readShort = [&ip]() -> uint16_t {
+        ip += 2;
+        return (ip[-2] << 8) | ip[-1];
+    };
+    auto token = [&]() -> const Token & { return chunk->tokens[readShort()]; };
+    auto line = [&]() -> int { return chunk->lines[ip - chunk->code.data() - 1]; };
+    auto undefined = [&](int slot) {
+        auto name = Symbols::name(globalSymbols[slot]);
+        throw RuntimeError(Token(IDENTIFIER, name, line(), 0, 0),
+                           "Undefined variable '" + std::string(name) + "'.");
+    };
+
+    // Integer and double operands of the same kind take the fast path, all
+    // other combinations get the tree-walker's promotion rules.
+    auto arithmetic = [&](auto op) {
+        const Token &optoken = token();
+        Lit &lhs = top[-2];
+        Lit &rhs = top[-1];
+        if (lhs.isInt() and rhs.isInt())
+            lhs = op(lhs.asInt(), rhs.asInt());
+        else if (lhs.isDouble() and rhs.isDouble())
+            lhs = op(lhs.asDouble(), rhs.asDouble());
+        else
+            lhs = Interpreter::binary(optoken, std::move(lhs), std::move(rhs));
+        --top;
+    };
+
+    for (;;) {
+        switch (readByte()) {
+        case OP_CONSTANT:
+            *top++ = chunk->constants[readShort()];
+            break;
+        case OP_NIL:   *top++ = nullptr; break;
+        case OP_TRUE:  *top++ = true; break;
+        case OP_FALSE: *top++ = false; break;
+        case OP_POP:   --top; break;
+        case OP_POPN:  top -= readByte(); break;
+
+        case OP_GET_LOCAL:
+            *top++ = frame->slots[readByte()];
+            break;
+        case OP_SET_LOCAL:
+            frame->slots[readByte()] = top[-1];
+            break;
+        case OP_GET_GLOBAL: {
+            uint16_t slot = readShort();
+            if (!defined[slot])
+                undefined(slot);
+            *top++ = globals[slot];
+            break;
+        }
+        case OP_SET_GLOBAL: {
+            uint16_t slot = readShort();
+            if (!defined[slot])
+                undefined(slot);
+            globals[slot] = top[-1];
+            break;
+        }
+        case OP_DEFINE_GLOBAL: {
+            uint16_t slot = readShort();
+            globals[slot] = std::move(top[-1]);
+            defined[slot] = true;
+            --top;
+            break;
+        }
+
+        case OP_EQUAL:
+            token();
+            top[-2] = Interpreter::isEqual(top[-2], top[-1]);
+            --top;
+            break;
+        case OP_NOT_EQUAL:
+            token();
+            top[-2] = !Interpreter::isEqual(top[-2], top[-1]);
+            --top;
+            break;
+        case OP_GREATER:
+            arithmetic([](auto a, auto b) -> Lit { return a > b; });
+            break;
+        case OP_GREATER_EQUAL:
+            arithmetic([](auto a, auto b) -> Lit { return a >= b; });
+            break;
+        case OP_LESS:
+            arithmetic([](auto a, auto b) -> Lit { return a < b; });
+            break;
+        case OP_LESS_EQUAL:
+            arithmetic([](auto a, auto b) -> Lit { return a <= b; });
+            break;
+        case OP_ADD:
+            arithmetic([](auto a, auto b) -> Lit { return a + b; });
+            break;
+        case OP_SUBTRACT:
+            arithmetic([](auto a, auto b) -> Lit { return a - b; });
+            break;
+        case OP_MULTIPLY:
+            arithmetic([](auto a, auto b) -> Lit { return a * b; });
+            break;
+        case OP_DIVIDE:
+            arithmetic([](auto a, auto b) -> Lit { return a / b; });
+            break;
+        case OP_SHIFT_LEFT:
+        case OP_SHIFT_RIGHT: {
+            // shifts are defined for integers only, leave the rest to
+            // Interpreter::binary for its error message
+            bool left = ip[-1] == OP_SHIFT_LEFT;
+            const Token &optoken = token();
+            Lit &lhs = top[-2];
+            Lit &rhs = top[-1];
+            if (lhs.isInt() and rhs.isInt())
+                lhs = left ? lhs.asInt() << rhs.asInt() : lhs.asInt() >> rhs.asInt();
+            else
+                lhs = Interpreter::binary(optoken, std::move(lhs), std::move(rhs));
+            --top;
+            break;
+        }
+
+        case OP_NOT:
+            top[-1] = !Interpreter::isTruthy(top[-1]);
+            break;
+        case OP_NEGATE: {
+            const Token &optoken = token();
+            top[-1] = Interpreter::negate(optoken, std::move(top[-1]));
+            break;
+        }
+
+        case OP_PRINT:
+            std::cout << WHITE << Interpreter::stringify(top[-1]) << std::endl;
+            --top;
+            break;
+
+        case OP_JUMP: {
+            uint16_t offset = readShort();
+            ip += offset;
+            break;
+        }
+        case OP_JUMP_IF_FALSE: {
+            uint16_t offset = readShort();
+            if (!Interpreter::isTruthy(top[-1]))
+                ip += offset;
+            break;
+        }
+        case OP_JUMP_IF_TRUE: {
+            uint16_t offset = readShort();
+            if (Interpreter::isTruthy(top[-1]))
+                ip += offset;
+            break;
+        }
+        case OP_LOOP: {
+            uint16_t offset = readShort();
+            ip -= offset;
+            break;
+        }
+
+        case OP_CALL: {
+            int argc = readByte();
+            const Token &paren = token();
+            Lit *callee = top - argc - 1;
+
+            if (!callee->isCallable())
+                throw RuntimeError(paren, "Can only call functions.");
+            auto function = callee->asCallable();
+
+            if (argc != function->arity())
+                throw RuntimeError(paren,
+                                   "Expect " + std::to_string(function->arity()) +
+                                       " arguments but got " +
+                                       std::to_string(argc) + ".");
+
+            if (typeid(*function) != typeid(vm::Function)) {
+                Lit result = function->call(nullptr, const_cast<Token &>(paren),
+                                            std::span<Lit>(callee + 1, argc));
+                top = callee;
+                *top++ = std::move(result);
+                break;
+            }
+
+            if (frameCount == FRAMES_MAX or
+                stack.data() + STACK_MAX - top < 2 * 256)
+                throw RuntimeError(paren, "Stack overflow.");
+
+            if (static_cast<vm::Function *>(function)->declaration)
+                finish(static_cast<vm::Function *>(function), paren);
+
+            frame->ip = ip;
+            frame = &frames[frameCount++];
+            frame->function = static_cast<vm::Function *>(function);
+            frame->ip = ip = frame->function->chunk.code.data();
+            frame->slots = callee;
+            chunk = &frame->function->chunk;
+            break;
+        }
+        case OP_RETURN: {
+            Lit result = std::move(top[-1]);
+            if (--frameCount == 0) {
+                top = stack.data();
+                return;
+            }
+
+            top = frame->slots;
+            *top++ = std::move(result);
+
+            frame = &frames[frameCount - 1];
+            ip = frame->ip;
+            chunk = &frame->function->chunk;
+            break;
+        }
+        }
+    }
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../Environment/Environment.h"
+#include "../Parser/Stmt.h"
+#include "../Types/Constants.h"
+#include "../Types/Token.h"
+#include "Chunk.h"
+
+namespace lox::vm {
+
+// Stack based virtual machine, an alternative to the tree-walking
+// Interpreter. Globals live in slots resolved by the Compiler, so they
+// persist across REPL lines just like Interpreter::globals.
+class VM {
+  private:
+    typedef Types::Literal Lit;
+
+    struct CallFrame {
+        Function *function;
+        const uint8_t *ip;
+        Lit *slots;
+    };
+
+    static constexpr int FRAMES_MAX = 1024;
+    static constexpr int STACK_MAX = FRAMES_MAX * 64;
+
+    std::vector<Lit> stack = std::vector<Lit>(STACK_MAX);
+    Lit *top = stack.data();
+
+    std::vector<CallFrame> frames = std::vector<CallFrame>(FRAMES_MAX);
+    int frameCount = 0;
+
+    // global slot of each symbol id, -1 if it has none yet
+    std::vector<int> globalSlots;
+    std::vector<int> globalSymbols;
+    std::vector<Lit> globals;
+    std::vector<bool> defined;
+
+    auto defineNative(const std::string &name, Types::Callable *native) -> void;
+    auto finish(Function *function, const Types::Token &paren) -> void;
+    auto run() -> void;
+
+  public:
+    VM();
+
+    auto globalSlot(int symbol) -> int;
+    auto globalCount() const -> int { return globalSymbols.size(); }
+    auto globalSymbol(int slot) const -> int { return globalSymbols[slot]; }
+
+    // nullptr when the statements do not compile
+    auto compile(std::vector<Stmt *> stmts, const Types::Constants &constants)
+        -> Function *;
+    auto interprete(Function *script) -> void;
+    auto interprete(std::vector<Stmt *> stmts, const Types::Constants &constants)
+        -> void;
+};
+
+} // namespace lox::vm
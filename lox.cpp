@@ -1,18 +1,27 @@
+#include <algorithm>
 #include <cstdlib>
 #include <exception>
-#include <fstream>
+#include <filesystem>
 #include <iostream>
 #include <memory>
 #include <mutex>
-#include <sstream>
 #include <vector>
 #include <unordered_map>
 
+#include "Cache/Cache.h"
 #include "Checker/Checker.h"
 #include "Interpreter/Interpreter.h"
+#include "Optimizer/DeadCode.h"
+#include "Optimizer/Effects.h"
+#include "Optimizer/Inliner.h"
+#include "Optimizer/LoopInvariant.h"
+#include "Optimizer/Optimizer.h"
+#include "Optimizer/TypeInference.h"
+#include "Parser/FlatAst.h"
 #include "Parser/Parser.h"
 #include "Scanner/Scanner.h"
 #include "Types/Token.h"
+#include "VM/VM.h"
 #include "tools/printer_ast.h"
 #include "tools/printer_identifiers.h"
 #include "tools/colors.h"
@@ -25,10 +34,18 @@ bool hadError = false;
 
 class Config {
 
-    void ast() { print_ast = true; }
-    void help() { print_help = true; }
-    void id_table() { print_id_table = true; }
-    void lex_table() { print_lex_table = true; }
+    void ast() { print_ast = true; interprete = false; }
+    void help() { print_help = true; interprete = false; }
+    void id_table() { print_id_table = true; interprete = false; }
+    void lex_table() { print_lex_table = true; interprete = false; }
+    void use_tree() { engine_vm = false; }
+    void use_vm() { engine_vm = true; }
+    void use_flat_ast() { flat_ast = true; }
+    void use_cache() { cache = true; }
+    void use_lazy() { lazy = true; }
+    void use_strict() { strict = true; }
+    void use_optimizer() { optimize = true; }
+    void report_dce() { optimize = true; print_dce = true; }
 
     std::unordered_map<std::string, void (Config::*)()> keys {
         {"--ast", &Config::ast},
@@ -39,6 +56,14 @@ class Config {
         {"-i", &Config::id_table},
         {"--lex-table", &Config::lex_table},
         {"-l", &Config::lex_table},
+        {"--engine=tree", &Config::use_tree},
+        {"--engine=vm", &Config::use_vm},
+        {"--flat-ast", &Config::use_flat_ast},
+        {"--cache", &Config::use_cache},
+        {"--lazy", &Config::use_lazy},
+        {"--strict", &Config::use_strict},
+        {"-O", &Config::use_optimizer},
+        {"--report-dce", &Config::report_dce},
     };
 
   public:
@@ -49,9 +74,19 @@ class Config {
     bool print_help = false;
     bool print_id_table = false;
     bool print_lex_table = false;
+    bool print_dce = false;
 
     bool prompt = true;
     bool interprete = true;
+    bool engine_vm = false;
+    bool flat_ast = false;
+    bool cache = false;
+    // --strict wins over --lazy, so CI can check everything up front
+    bool lazy = false;
+    bool strict = false;
+    bool optimize = false;
+    // threads of the front end, see parseParallel()
+    int jobs = 1;
 
     Config(int argc, char* argv[]) {
         if (argc == 1) return;
@@ -69,71 +104,237 @@ class Config {
                 continue;
             }
 
+            if (arg == std::string_view("--jobs")) {
+                jobs = i + 1 < argc ? std::atoi(argv[++i]) : 0;
+                if (jobs < 1) {
+                    std::cerr << RED "--jobs expects a positive number" << std::endl;
+                    std::exit(64);
+                }
+                continue;
+            }
+
             if (not keys.contains(arg)) {
                 std::cerr << RED "unknown argument: " << arg << std::endl;
                 std::exit(64);
             }
             (this->*keys[arg])();
-            interprete = false;
         }
     }
 
 };
 
+// The engines keep their globals across REPL lines. Declared functions keep
+// pointing into the syntax tree, compiled ones keep tokens for error
+// reporting, so whatever they point into lives as long as the engines.
+auto treeEngine() -> Interpreter & {
+    static Interpreter interpreter;
+    return interpreter;
+}
+auto vmEngine() -> vm::VM & {
+    static vm::VM vm;
+    return vm;
+}
+std::vector<Program> retained;
+std::vector<std::unique_ptr<flat::Tree>> retained_flat;
+std::vector<std::shared_ptr<const Source>> retained_sources;
+
+// Runs the cached form of an unchanged script, false when there is none.
+bool runCached(const std::shared_ptr<const Source>& input, const std::string& path,
+               uint64_t key, Config& config) {
+    if (config.engine_vm) {
+        auto& vm = vmEngine();
+        auto script = cache::loadScript(path, key, vm, *input);
+        if (not script)
+            return false;
+        retained_sources.push_back(input);
+        vm.interprete(script);
+        return true;
+    }
+
+    auto tree = cache::loadTree(path, key, input);
+    if (not tree)
+        return false;
+    treeEngine().interprete(*tree);
+    retained_flat.push_back(std::move(tree));
+    return true;
+}
+
+// --jobs: the pre-parse skips the function bodies, the top level is checked
+// on this thread and the bodies are parsed and checked on the workers.
+// Errors are held back and reported in source order, parse errors first,
+// as a single thread would report them.
+Program parseParallel(Scanner& scanner, Checker& checker, int jobs) {
+    std::vector<ErrorEntry> parse_errors;
+    std::vector<ErrorEntry> check_errors;
+
+    Program program;
+    {
+        ErrorLog log;
+        program = Parser(scanner, true).parse();
+        parse_errors = std::move(log.entries);
+    }
+    {
+        ErrorLog log;
+        checker.check(program.statements);
+        check_errors = std::move(log.entries);
+    }
+    if (program.lazy)
+        checker.complete(*program.lazy, jobs, parse_errors, check_errors);
+
+    for (auto errors : {&parse_errors, &check_errors}) {
+        std::stable_sort(errors->begin(), errors->end(),
+                [](auto& lhs, auto& rhs) { return lhs.line < rhs.line; });
+        for (auto& error : *errors)
+            report(error.line, error.stage, error.msg);
+    }
+    return program;
+}
+
 std::once_flag flag_id_print_natives;
-void run(std::string &&input, Config& config) {
+void run(std::shared_ptr<const Source> input, Config& config) {
+    // scripts run with --cache are keyed by their text and -O; --report-dce
+    // needs the Optimizer to run. Only a regular file named as such is
+    // cached: a pipe, or a link like /dev/stdin, would get a cache file
+    // next to a path that never holds the same script again
+    std::string cache_path;
+    uint64_t key = 0;
+    std::error_code ignored;
+    if (config.cache and config.interprete and not config.prompt
+        and not config.print_dce and input->isMapped()
+        and std::filesystem::is_regular_file(
+                std::filesystem::symlink_status(config.file, ignored))) {
+        key = cache::hash(input->text(), config.optimize);
+        cache_path = cache::path(config.file, key, config.optimize,
+                config.engine_vm ? cache::VM : cache::TREE);
+        if (runCached(input, cache_path, key, config))
+            return;
+    }
+
     Scanner scanner(std::move(input));
-    std::vector<Types::Token> tokens = scanner.scanTokens();
+    // a large source is cut into chunks scanned on the --jobs threads before
+    // the parser pulls its first token
+    if (config.jobs > 1)
+        scanner.scanTokens(config.jobs);
 
     if (config.print_lex_table) {
+        auto& tokens = scanner.scanTokens();
         int line = 0;
-        for (auto& token : tokens) {
-            while (line != token.line()) {
+        for (int i = tokens.begin(); i < tokens.end(); ++i) {
+            while (line != tokens.line(i)) {
                 line++;
                 std::cout << "\n[" << line << "]\t";
             }
-            std::cout << Types::TokenTypeString(token.type()) << " ";
+            std::cout << Types::TokenTypeString(tokens.type(i)) << " ";
         }
         std::cout << std::endl;
     }
 
-    Parser parser(tokens);
-    auto stmts = parser.parse();
-
+    // the flat form, the cache, the printers and the Optimizer need every
+    // function body
+    bool lazy = config.lazy and not config.strict and config.interprete
+                and not config.flat_ast and cache_path.empty()
+                and not config.optimize;
     static Checker checker;
-    checker.check(stmts);
+    bool parallel = config.jobs > 1;
+    Program program = parallel ? parseParallel(scanner, checker, config.jobs)
+                               : Parser(scanner, lazy).parse();
+    program.source = scanner.buffer();
+    program.constants = scanner.constants();
+    auto& stmts = program.statements;
+
+    // every walker but the bytecode compiler can take the flat form instead,
+    // the tree engine caches it
+    bool flat_ast = config.flat_ast or not cache_path.empty();
+    bool flat_tree = flat_ast and not (config.interprete and config.engine_vm);
+    std::unique_ptr<flat::Tree> tree;
+
+    // the parallel front end has checked the program already, the Optimizer
+    // rewrites the checked pointer tree, which is flattened afterwards
+    if (flat_tree and not parallel and not config.optimize) {
+        tree = std::make_unique<flat::Tree>(flat::flatten(program));
+        checker.check(*tree);
+    } else if (not parallel)
+        checker.check(stmts);
 
     if (hadError)
         return;
 
+    if (config.optimize) {
+        // the REPL may redefine any global in a later line
+        if (not config.prompt)
+            Inliner(program.arena()).inlineCalls(stmts);
+        Optimizer(program.arena(), *scanner.constants()).optimize(stmts);
+        TypeInference(*program.constants).infer(stmts);
+        // or redefine a native
+        Effects effects(*program.constants, config.prompt ? nullptr : &stmts);
+        LoopInvariant(program.arena(), effects).hoist(stmts);
+        // or use it
+        DeadCode dead_code(program.arena(), effects, not config.prompt);
+        dead_code.eliminate(stmts);
+        if (config.print_dce)
+            dead_code.report(std::clog);
+    }
+    if (flat_tree and not tree)
+        tree = std::make_unique<flat::Tree>(flat::flatten(program));
+
     if (config.print_ast) {
         tools::AstPrinter printer(std::cout);
-        printer.print(stmts);
+        if (tree)
+            printer.print(*tree);
+        else
+            printer.print(stmts, *program.constants);
     }
 
     if (config.print_id_table) {
         static tools::IdPrinter printer(std::cout);
         std::call_once(flag_id_print_natives,
                 &tools::IdPrinter::print_natives, &printer);
-        printer.print(stmts);
+        if (tree)
+            printer.print(*tree);
+        else
+            printer.print(stmts, *program.constants);
     }
 
-    if (config.interprete) {
-        static Interpreter interpreter;
-        interpreter.interprete(stmts);
+    if (config.interprete and config.engine_vm) {
+        auto& vm = vmEngine();
+        auto script = vm.compile(stmts, *program.constants);
+        if (not script)
+            return;
+        if (not cache_path.empty())
+            cache::save(cache_path, key, vm, script, *program.source);
+        vm.interprete(script);
+
+        // functions compiled on their first call need their syntax tree
+        if (program.has_functions and lazy)
+            retained.push_back(std::move(program));
+        else if (program.has_functions)
+            retained_sources.push_back(program.source);
+    } else if (config.interprete) {
+        auto& interpreter = treeEngine();
+        if (tree) {
+            if (not cache_path.empty())
+                cache::save(cache_path, key, *tree);
+            interpreter.interprete(*tree);
+            if (program.has_functions)
+                retained_flat.push_back(std::move(tree));
+        } else {
+            interpreter.interprete(stmts, *program.constants);
+            if (program.has_functions)
+                retained.push_back(std::move(program));
+        }
     }
 }
 
 void runFile(Config& config) {
-    std::ifstream file(config.file);
-
-    std::stringstream buf;
-    buf << file.rdbuf();
+    auto source = Source::open(config.file);
+    if (not source) {
+        std::cerr << RED "can't read " << config.file << std::endl;
+        std::exit(66);
+    }
 
-    std::string str = buf.str();
     // delete trailing newline
-    str.pop_back();
-    run(std::move(str), config);
+    source->trim();
+    run(std::move(source), config);
 
     if (hadRuntimeError)
         std::exit(70);
@@ -163,7 +364,7 @@ void runPrompt(Config& config) {
         if (str.empty())
             break;
 
-        run(std::move(str), config);
+        run(std::make_shared<const Source>(std::move(str)), config);
         hadRuntimeError = false;
         hadError = false;
         std::cout << "\n\e[33m>> " GREEN;
@@ -184,10 +385,23 @@ int main(int argc, char *argv[]) {
 
 void print_help() {
     std::cout << "Usage: zrv [keys] [script]\n";
-    std::cout << "Any flag will turn interpretation off. Can be combine together.\n";
+    std::cout << "The printing flags -a, -i, -l and -h turn interpretation off; --engine, --flat-ast,\n";
+    std::cout << "--lazy, --strict, --jobs, -O, --report-dce and --cache keep it on. Can be combined together.\n";
     std::cout << "Avaible keys:\n";
     std::cout << "\t-h\t--help\t\tprints this message\n";
     std::cout << "\t-a\t--ast\t\tprints abstract syntax tree\n";
     std::cout << "\t-i\t--id-table\tprints table of identifiers\n";
     std::cout << "\t-l\t--lex-table\tprints table of lexemes types\n";
+    std::cout << "\t\t--engine=tree\tinterprete by walking the syntax tree (default)\n";
+    std::cout << "\t\t--engine=vm\tcompile to bytecode and run it on the stack VM\n";
+    std::cout << "\t\t--flat-ast\twalk a flat, index based copy of the syntax tree\n";
+    std::cout << "\t\t--lazy\t\tparse and check function bodies on their first call\n";
+    std::cout << "\t\t--strict\tparse and check everything up front, even with --lazy\n";
+    std::cout << "\t\t--jobs N\tscan a large script and parse and check the function bodies on N threads\n";
+    std::cout << "\t-O\t\t\tinline small functions, fold constants, prove numeric\n";
+    std::cout << "\t\t\t\ttypes, hoist loop invariants and remove dead code;\n";
+    std::cout << "\t\t\t\twith -a prints the optimized tree\n";
+    std::cout << "\t\t--report-dce\tlist the dead code -O removes\n";
+    std::cout << "\t\t--cache\t\treuse the compiled script from an earlier run with the same text and -O;\n";
+    std::cout << "\t\t\t\tkept next to the script or in $LOX_CACHE_DIR\n";
 }
@@ -3,12 +3,25 @@
 #include <iostream>
 #include <fstream>
 #include <filesystem>
+#include <string>
 #include <vector>
 using namespace std;
 
-void defineAst(string outputDir, string baseName, vector<pair<string, string>> types);
-void defineType(ostream& os, const string& base, const string& className, const vector<pair<string, string>>& params);
-void defineVisitor(ostream& os, const string& base, const vector<pair<string, string>> types);
+// One node class. Fields are constructor parameters, extras are members
+// filled in by later passes and carry their initializer. Both are written
+// as "Type name" and may end with a "// comment" that is put above them.
+struct NodeType {
+    string name;
+    vector<string> fields;
+    vector<string> extras = {};
+};
+
+void defineAst(string outputDir, string baseName, string result, vector<NodeType> types);
+void defineKinds(ostream& os, const string& base, const vector<NodeType>& types);
+void defineVisitor(ostream& os, const string& base, const string& result, const vector<NodeType>& types);
+void defineStaticVisitor(ostream& os, const string& base, const string& result);
+void defineDispatch(ostream& os, const string& base, const string& result, const vector<NodeType>& types);
+void defineType(ostream& os, const string& base, const string& result, const NodeType& type);
 
 
 int main(int argc, char* argv[])
@@ -19,20 +32,78 @@ int main(int argc, char* argv[])
         exit(64);
     }
 
-    //defineAst(argv[1], "Expr", vector<pair<string, string>> {
-    //        { "BinaryExpr",    "Expr* left, Types::Token op, Expr* right" },
-    //        { "GroupingExpr",  "Expr* expr" },
-    //        { "LiteralExpr",   "Types::OptionalLiteral value" },
-    //        { "UnaryExpr",     "Types::Token op, Expr* right" }
-    //    });
+    defineAst(argv[1], "Expr", "Types::Literal", {
+            { "Binary",     { "Expr* left", "Types::Token op", "Expr* right" },
+                            { "Types::Value::Kind operands = Types::Value::NIL // INT or DOUBLE when TypeInference proved both operands to be of that kind" } },
+            { "Grouping",   { "Expr* expr" } },
+            { "Literal",    { "int constant // index into the program's Types::Constants" } },
+            { "Unary",      { "Types::Token op", "Expr* right" } },
+            { "Variable",   { "Types::Token name" },
+                            { "int depth = -1 // resolved by Checker, depth -1 means global",
+                              "int slot = -1" } },
+            { "Assign",     { "Types::Token name", "Expr* value" },
+                            { "int depth = -1 // resolved by Checker, depth -1 means global",
+                              "int slot = -1" } },
+            { "Logical",    { "Expr* left", "Types::Token op", "Expr* right" } },
+            { "Call",       { "Expr* callee", "Types::Token paren", "std::vector<Expr*> arguments" },
+                            { "Expr* inlined = nullptr // body of the callee with the arguments in place of the parameters, evaluated instead of the call; set by Inliner" } },
+        });
 
-    defineAst(argv[1], "Stmt", vector<pair<string, string>> {
-            { "Expression",     "Expr* expr" },
-            { "Print",          "Expr* expr" }
+    defineAst(argv[1], "Stmt", "void", {
+            { "Expression", { "Expr* expr" } },
+            { "Print",      { "Expr* expr" } },
+            { "Var",        { "Types::Token name", "Expr* init" },
+                            { "int slot = -1 // local slot assigned by Checker, -1 for globals" } },
+            { "Block",      { "std::vector<Stmt*> statements" },
+                            { "int frame = -1 // slots of the block, set by Checker; -1 runs it in a heap Environment" } },
+            { "If",         { "Expr* condition", "Stmt* thenBranch", "Stmt* elseBranch" } },
+            { "While",      { "Expr* condition", "Stmt* body" } },
+            { "Function",   { "Types::Token name", "std::vector<Types::Token> params", "std::vector<Stmt*> body" },
+                            { "int slot = -1 // local slot assigned by Checker, -1 for globals",
+                              "LazyBody* lazy = nullptr // set while the body is only brace matched, see Lazy.h" } },
+            { "Return",     { "Types::Token keyword", "Expr* expr" } },
         });
 }
 
-void defineAst(string outputDir, string baseName, vector<pair<string, string>> types)
+string toLower(string str)
+{
+    transform(str.begin(), str.end(), str.begin(),
+            [](unsigned char c) { return tolower(c); });
+    return str;
+}
+
+string toUpper(string str)
+{
+    transform(str.begin(), str.end(), str.begin(),
+            [](unsigned char c) { return toupper(c); });
+    return str;
+}
+
+// "Type name // comment" -> {declaration, comment}
+pair<string, string> splitComment(const string& field)
+{
+    auto slash = field.find("//");
+    if (slash == string::npos)
+        return {field, ""};
+
+    auto declaration = field.substr(0, field.find_last_not_of(' ', slash - 1) + 1);
+    return {declaration, field.substr(slash + 3)};
+}
+
+// only the containers are worth moving
+string passOn(const string& type, const string& name)
+{
+    return type.starts_with("std::") ? "std::move(" + name + ")" : name;
+}
+
+// "Type name" -> {type, name}
+pair<string, string> splitField(const string& declaration)
+{
+    auto space = declaration.rfind(' ');
+    return {declaration.substr(0, space), declaration.substr(space + 1)};
+}
+
+void defineAst(string outputDir, string baseName, string result, vector<NodeType> types)
 {
     // create directory if it doesnt already exist
     filesystem::create_directories(outputDir);
@@ -43,85 +114,145 @@ void defineAst(string outputDir, string baseName, vector<pair<string, string>> t
 
     file << "// This file was generated by GenerateAst\n";
     file << "#pragma once\n";
-    file << "#include \"../Types/Token.h\"\n\n";
-    file << "using namespace lox;\n\n";
+    file << "#include <cstdint>\n";
+    file << "#include <utility>\n";
+    file << "#include <vector>\n\n";
+    file << "#include \"../Types/Token.h\"\n";
+    file << "#include \"Arena.h\"\n";
+    if (baseName != "Expr") {
+        file << "#include \"Expr.h\"\n";
+        file << "#include \"Lazy.h\"\n";
+    }
+    file << "\nusing namespace lox;\n\n";
 
     // forward declaration
-    for (auto& [type, fields] : types)
-        file << "class " << type << ";\n";
+    file << "class " << baseName << ";\n";
+    for (auto& type : types)
+        file << "class " << type.name << baseName << ";\n";
     file << "\n";
 
-    defineVisitor(file, baseName, types);
+    defineKinds(file, baseName, types);
+    defineVisitor(file, baseName, result, types);
+    defineStaticVisitor(file, baseName, result);
 
     file << "class " << baseName << " {\n";
     file << "public:\n";
-    file << "\t" << baseName << "() = default;\n";
-    file << "\tvirtual ~" << baseName << "() = default;\n";
-    file << "\tvirtual void accept(ExprVisitor* visitor) = 0;\n";
+    file << "    const " << baseName << "Kind kind;\n\n";
+    file << "    virtual " << result << " accept(" << baseName << "Visitor* visitor) = 0;\n\n";
+    file << "protected:\n";
+    file << "    " << baseName << "(" << baseName << "Kind kind) : kind(kind) { }\n";
+    file << "    // nodes are owned by an Arena and never deleted through the base,\n";
+    file << "    // so the ones without heap members need no finalizer\n";
+    file << "    ~" << baseName << "() = default;\n";
     file << "};\n\n";
 
-    for (auto& [type, fields] : types) {
+    for (auto& type : types)
+        defineType(file, baseName, result, type);
 
-        istringstream typestream (fields);
-        vector<pair<string, string>> params;
+    defineDispatch(file, baseName, result, types);
 
-        while (typestream)
-        {
-            string type;
-            string name;
-            typestream >> type;
-            typestream >> ws;
-            getline(typestream, name, ',');
-            params.push_back({std::move(type), std::move(name)});
-        }
+    file.flush();
+}
 
-        params.pop_back();
-        defineType(file, baseName, type, params);
-    }
+void defineKinds(ostream& os, const string& base, const vector<NodeType>& types)
+{
+    os << "enum class " << base << "Kind : uint8_t {\n";
+    for (auto& type : types)
+        os << "    " << toUpper(type.name) << ",\n";
+    os << "};\n\n";
+}
 
-    file.flush();
+void defineVisitor(ostream& os, const string& base, const string& result, const vector<NodeType>& types)
+{
+    os << "class " << base << "Visitor {\n";
+    os << "public:\n";
+    os << "    virtual ~" << base << "Visitor() = default;\n";
+
+    for (auto& type : types)
+        os << "    virtual " << result << " visit(" << type.name << base
+           << "* " << toLower(base) << ") = 0;\n";
+
+    os << "};\n\n";
+}
+
+void defineStaticVisitor(ostream& os, const string& base, const string& result)
+{
+    os << "// Visitor without virtual calls: dispatch" << base << "() switches on the kind\n";
+    os << "// and calls Derived::visit directly, where it can be inlined.\n";
+    os << "template <class Derived>\n";
+    os << "class " << base << "StaticVisitor {\n";
+    os << "public:\n";
+    os << "    " << result << " dispatch" << base << "(" << base << "* " << toLower(base) << ");\n";
+    os << "};\n\n";
+}
+
+void defineDispatch(ostream& os, const string& base, const string& result, const vector<NodeType>& types)
+{
+    auto var = toLower(base);
+
+    os << "template <class Derived>\n";
+    os << "inline " << result << " " << base << "StaticVisitor<Derived>::dispatch" << base
+       << "(" << base << "* " << var << ") {\n";
+    os << "    auto self = static_cast<Derived*>(this);\n";
+    os << "    switch (" << var << "->kind) {\n";
+    for (auto& type : types)
+        os << "    case " << base << "Kind::" << toUpper(type.name) << ": return self->visit(static_cast<"
+           << type.name << base << "*>(" << var << "));\n";
+    os << "    }\n";
+    if (result != "void")
+        os << "    return " << result << "();\n";
+    os << "}\n";
 }
 
-void defineType(ostream& os, const string& base, const string& className, const vector<pair<string, string>>& params)
+void defineType(ostream& os, const string& base, const string& result, const NodeType& type)
 {
+    auto className = type.name + base;
+
+    vector<pair<string, string>> params;
     os << "class " << className << " : public " << base << " {\n";
     os << "public:\n";
 
     // fields of class
-    for (size_t i{} ; i < params.size(); ++i)
-        os << "\t" << params[i].first << " " << params[i].second << ";\n";
+    for (auto& field : type.fields) {
+        auto [declaration, comment] = splitComment(field);
+        if (!comment.empty())
+            os << "    // " << comment << "\n";
+        os << "    " << declaration << ";\n";
+        params.push_back(splitField(declaration));
+    }
+    for (auto& extra : type.extras) {
+        auto [declaration, comment] = splitComment(extra);
+        if (!comment.empty())
+            os << "    // " << comment << "\n";
+        os << "    " << declaration << ";\n";
+    }
     os << "\n";
 
     // constructor
-    os << "\t" << className << "(";
+    os << "    " << className << "(";
     for (size_t i{} ; i < params.size(); ++i)
         os << params[i].first << " " << params[i].second << (i != params.size() - 1 ? ", " : "");
     os << ") :\n";
-    os << "\t\t";
+    os << "        " << base << "(" << base << "Kind::" << toUpper(type.name) << ")";
+    for (auto& [type, name] : params)
+        os << ", " << name << "(" << passOn(type, name) << ")";
+    os << "\n    { }\n";
+
+    // factory
+    os << "    static " << className << "* create(Arena& arena";
+    for (auto& [type, name] : params)
+        os << ", " << type << " " << name;
+    os << ") {\n";
+    os << "        return arena.make<" << className << ">(";
     for (size_t i{} ; i < params.size(); ++i)
-        os << params[i].second << "(" << params[i].second << ")" << (i != params.size() - 1 ? ", " : "\n\t{ }\n");
+        os << passOn(params[i].first, params[i].second) << (i != params.size() - 1 ? ", " : "");
+    os << ");\n";
+    os << "    }\n";
 
     // accept function
-    os << "\tvoid accept(ExprVisitor* visitor) override {\n";
-    os << "\t\tvisitor->visit" << "(this);\n";
-    os << "\t};\n";
+    os << "    " << result << " accept(" << base << "Visitor* visitor) override {\n";
+    os << "        " << (result == "void" ? "" : "return ") << "visitor->visit(this);\n";
+    os << "    };\n";
 
     os << "};\n\n";
 }
-
-void defineVisitor(ostream& os, const string& base, const vector<pair<string, string>> types)
-{
-    os << "class ExprVisitor {\n";
-    os << "public:\n";
-    os << "\tvirtual ~ExprVisitor() = default;\n";
-
-    string base_lower(base);
-    transform(base_lower.begin(), base_lower.end(), base_lower.begin(),
-            [](unsigned char c) { return tolower(c); });
-
-    for (auto& type : types)
-        os << "\tvirtual void visit" << "(" << type.first 
-           << "* " << base_lower << ") = 0;\n";
-
-    os << "};\n";
-}
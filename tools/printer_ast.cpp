@@ -1,5 +1,6 @@
 #include "printer_ast.h"
 #include "colors.h"
+#include <array>
 #include <memory>
 using namespace lox::tools;
 
@@ -16,7 +17,9 @@ auto AstPrinter::print(Stmt *stmt) -> void {
     out << COLOR_STMT;
 }
 
-auto AstPrinter::print(std::vector<Stmt *> statements) -> void {
+auto AstPrinter::print(std::vector<Stmt *> statements,
+                       const Types::Constants &pool) -> void {
+    constants = &pool;
     out << COLOR_STMT;
     for (auto statement : statements)
         print(statement);
@@ -31,7 +34,7 @@ auto AstPrinter::println(const std::string &str) -> void {
     out << std::string(nest_level, '\t') << str << std::endl;
 }
 
-void AstPrinter::parenthesize(const std::string &name,
+void AstPrinter::parenthesize(std::string_view name,
                               const std::vector<Expr *> exprs) {
     out << "(" COLOR_OP << name;
     for (auto &expr : exprs) {
@@ -42,12 +45,25 @@ void AstPrinter::parenthesize(const std::string &name,
     out << ")";
 }
 
-auto AstPrinter::stringify(Lit &value) -> std::string {
-    return std::visit(Types::Stringify(), value);
+auto AstPrinter::stringify(const Lit &value) -> std::string {
+    return Types::visit(Types::Stringify(), value);
+}
+
+auto AstPrinter::binaryOperator(std::string_view op, uint32_t operands)
+    -> std::string {
+    switch (operands) {
+    case Types::Value::INT:
+        return std::string(op) + ":int";
+    case Types::Value::DOUBLE:
+        return std::string(op) + ":double";
+    default:
+        return std::string(op);
+    }
 }
 
 auto AstPrinter::visit(BinaryExpr *expr) -> Types::Literal {
-    parenthesize(expr->op.lexeme(), {expr->left, expr->right});
+    parenthesize(binaryOperator(expr->op.lexeme(), expr->operands),
+                 {expr->left, expr->right});
     return nullptr;
 }
 
@@ -57,7 +73,7 @@ auto AstPrinter::visit(GroupingExpr *expr) -> Types::Literal {
 }
 
 auto AstPrinter::visit(LiteralExpr *expr) -> Types::Literal {
-    out << COLOR_LITERAL "<" << stringify(expr->value) << ">" COLOR_EXPR;
+    out << COLOR_LITERAL "<" << stringify((*constants)[expr->constant]) << ">" COLOR_EXPR;
     return nullptr;
 }
 
@@ -83,6 +99,12 @@ auto AstPrinter::visit(AssignExpr *expr) -> Lit {
 }
 
 auto AstPrinter::visit(CallExpr *expr) -> Lit {
+    if (expr->inlined) {
+        auto callee = static_cast<VariableExpr *>(expr->callee)->name.lexeme();
+        parenthesize("inline " + std::string(callee), {expr->inlined});
+        return nullptr;
+    }
+
     std::vector<Expr *> arguments{expr->callee};
     arguments.insert(arguments.end(), expr->arguments.begin(),
                      expr->arguments.end());
@@ -109,7 +131,7 @@ auto AstPrinter::visit(PrintStmt *stmt) -> void {
 auto AstPrinter::visit(VarStmt *stmt) -> void {
     println("VarStmt: ");
     LocalNestLevel local_nest(nest_level);
-    println("VarName: " COLOR_INER + stmt->name.lexeme());
+    println("VarName: " COLOR_INER + std::string(stmt->name.lexeme()));
     if (stmt->init) {
         print(COLOR_STMT "InitExpr: ");
         print(stmt->init);
@@ -119,7 +141,7 @@ auto AstPrinter::visit(VarStmt *stmt) -> void {
 auto AstPrinter::visit(BlockStmt *stmt) -> void {
     println("BlockStmt:");
     LocalNestLevel local_nest(nest_level);
-    print(stmt->statements);
+    print(stmt->statements, *constants);
 }
 
 auto AstPrinter::visit(IfStmt *stmt) -> void {
@@ -152,17 +174,17 @@ auto AstPrinter::visit(WhileStmt *stmt) -> void {
 }
 
 auto AstPrinter::visit(FunctionStmt *stmt) -> void {
-    println("FunctionStmt: " COLOR_INER + stmt->name.lexeme());
+    println("FunctionStmt: " COLOR_INER + std::string(stmt->name.lexeme()));
     LocalNestLevel local_nest(nest_level);
 
     std::string params{};
     for (auto &token : stmt->params)
-        params += token.lexeme() + " ";
+        params += std::string(token.lexeme()) + " ";
     println(COLOR_STMT "Parameters: " COLOR_INER + params);
 
     println(COLOR_STMT "Body: ");
     LocalNestLevel body_nest(nest_level);
-    print(stmt->body);
+    print(stmt->body, *constants);
 }
 
 auto AstPrinter::visit(ReturnStmt *stmt) -> void {
@@ -171,3 +193,174 @@ auto AstPrinter::visit(ReturnStmt *stmt) -> void {
     print("Expr: ");
     print(stmt->expr);
 }
+
+
+// flat syntax tree
+auto AstPrinter::print(const flat::Tree &code) -> void {
+    tree = &code;
+    constants = code.constants.get();
+    printList(tree->statements);
+}
+
+auto AstPrinter::printList(flat::Index list) -> void {
+    out << COLOR_STMT;
+    for (auto statement : tree->list(list))
+        print(statement);
+    out << WHITE;
+}
+
+void AstPrinter::parenthesize(std::string_view name,
+                              std::span<const flat::Index> exprs) {
+    out << "(" COLOR_OP << name;
+    for (auto expr : exprs) {
+        out << " " COLOR_ARG;
+        expression(expr);
+        out << COLOR_EXPR;
+    }
+    out << ")";
+}
+
+auto AstPrinter::expression(flat::Index index) -> void {
+    using namespace flat;
+    auto &node = (*tree)[index];
+    switch (node.kind) {
+    case BINARY:
+        parenthesize(binaryOperator(tree->token(node.token).lexeme(), node.c),
+                     std::array{node.a, node.b});
+        break;
+    case LOGICAL:
+        parenthesize(tree->token(node.token).lexeme(), std::array{node.a, node.b});
+        break;
+    case GROUPING:
+        parenthesize("group", std::array{node.a});
+        break;
+    case LITERAL:
+        out << COLOR_LITERAL "<" << stringify((*constants)[node.a]) << ">" COLOR_EXPR;
+        break;
+    case UNARY:
+        parenthesize(tree->token(node.token).lexeme(), std::array{node.a});
+        break;
+    case VARIABLE:
+        out << tree->token(node.token).lexeme();
+        break;
+    case ASSIGN:
+        out << "(" COLOR_OP "= " COLOR_ARG << tree->token(node.token).lexeme()
+            << COLOR_EXPR " " COLOR_ARG;
+        expression(node.a);
+        out << COLOR_EXPR ")";
+        break;
+    case CALL: {
+        if (node.c != NONE) {
+            auto callee = tree->token((*tree)[node.a].token).lexeme();
+            parenthesize("inline " + std::string(callee), std::array{node.c});
+            break;
+        }
+        std::vector<Index> arguments{node.a};
+        auto list = tree->list(node.b);
+        arguments.insert(arguments.end(), list.begin(), list.end());
+        parenthesize("()", arguments);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+auto AstPrinter::print(flat::Index index) -> void {
+    using namespace flat;
+    auto &node = (*tree)[index];
+    if (node.kind < EXPRESSION) {
+        out << COLOR_EXPR;
+        expression(index);
+        out << "\n" COLOR_STMT;
+        return;
+    }
+
+    switch (node.kind) {
+    case EXPRESSION: {
+        println("ExpressionStmt:");
+        LocalNestLevel local_nest(nest_level);
+        print("Expr: ");
+        print(node.a);
+        break;
+    }
+    case PRINT: {
+        println("PrintStmt:");
+        LocalNestLevel local_nest(nest_level);
+        print("Expr: ");
+        print(node.a);
+        break;
+    }
+    case VAR: {
+        println("VarStmt: ");
+        LocalNestLevel local_nest(nest_level);
+        println("VarName: " COLOR_INER + std::string(tree->token(node.token).lexeme()));
+        if (node.a != NONE) {
+            print(COLOR_STMT "InitExpr: ");
+            print(node.a);
+        }
+        break;
+    }
+    case BLOCK: {
+        println("BlockStmt:");
+        LocalNestLevel local_nest(nest_level);
+        printList(node.a);
+        break;
+    }
+    case IF: {
+        println("IfStmt:");
+        LocalNestLevel local_nest(nest_level);
+        print("Condition: ");
+        print(node.a);
+
+        println("ThenBranch: ");
+        {
+            LocalNestLevel branch_nest(nest_level);
+            print(node.b);
+        }
+
+        if (node.c != NONE) {
+            println("ElseBranch: ");
+            LocalNestLevel branch_nest(nest_level);
+            print(node.c);
+        }
+        break;
+    }
+    case WHILE: {
+        println("WhileStmt:");
+        LocalNestLevel local_nest(nest_level);
+        print("Condition: ");
+        print(node.a);
+        println("Body: ");
+        LocalNestLevel body_nest(nest_level);
+        print(node.b);
+        break;
+    }
+    case FUNCTION: {
+        println("FunctionStmt: " COLOR_INER + std::string(tree->token(node.token).lexeme()));
+        LocalNestLevel local_nest(nest_level);
+
+        std::string params{};
+        for (Index param = 1; param <= node.a; ++param)
+            params += std::string(tree->token(node.token + param).lexeme()) + " ";
+        println(COLOR_STMT "Parameters: " COLOR_INER + params);
+
+        println(COLOR_STMT "Body: ");
+        LocalNestLevel body_nest(nest_level);
+        printList(node.b);
+        break;
+    }
+    case RETURN: {
+        println("ReturnStmt:");
+        LocalNestLevel local_nest(nest_level);
+        if (node.a != NONE) {
+            print("Expr: ");
+            print(node.a);
+        }
+        break;
+    }
+    default:
+        break;
+    }
+    out << COLOR_STMT;
+}
@@ -1,9 +1,12 @@
 #pragma once
 #include <iostream>
+#include <span>
 #include <vector>
 
 #include "../Parser/Expr.h"
+#include "../Parser/FlatAst.h"
 #include "../Parser/Stmt.h"
+#include "../Types/Constants.h"
 
 namespace lox::tools {
 class AstPrinter : public ExprVisitor, public StmtVisitor {
@@ -20,20 +23,31 @@ class AstPrinter : public ExprVisitor, public StmtVisitor {
 
     std::ostream &out;
     int nest_level{};
+    const Types::Constants *constants = nullptr;
+    const flat::Tree *tree = nullptr;
 
-    auto parenthesize(const std::string &name, const std::vector<Expr *> exprs)
+    auto parenthesize(std::string_view name, const std::vector<Expr *> exprs)
+        -> void;
+    auto parenthesize(std::string_view name, std::span<const flat::Index> exprs)
         -> void;
 
-    auto stringify(Lit &lit) -> std::string;
+    auto stringify(const Lit &lit) -> std::string;
+    // operator with the kind TypeInference proved for its operands
+    auto binaryOperator(std::string_view op, uint32_t operands) -> std::string;
     auto print(const std::string &name) -> void;
     auto println(const std::string &name) -> void;
     auto print(Stmt *stmt) -> void;
     auto print(Expr *expr) -> void;
+    auto print(flat::Index node) -> void;
+    auto printList(flat::Index list) -> void;
+    auto expression(flat::Index node) -> void;
 
   public:
     AstPrinter(std::ostream &out = std::clog) : out(out) {}
 
-    auto print(std::vector<Stmt *> statements) -> void;
+    auto print(std::vector<Stmt *> statements, const Types::Constants &pool)
+        -> void;
+    auto print(const flat::Tree &tree) -> void;
 
     auto visit(BinaryExpr *expr) -> Lit override;
     auto visit(LogicalExpr *expr) -> Lit override;
@@ -15,11 +15,13 @@ auto IdPrinter::print_natives() -> void {
     out << std::format(" /{:^13}/{:^13}/{:^15}/", "Name", "Type", "Value") << "\n";
     for (auto& [name, value] : natives)
         out << std::vformat("|{:^13}|{:^13}|{:^15}|", std::make_format_args(
-                name, std::visit(Types::Typify(), value),
+                name, Types::visit(Types::Typify(), value),
                 stringify(value))) << "\n";
 }
 
-auto IdPrinter::print(std::vector<Stmt *> statements) -> void {
+auto IdPrinter::print(std::vector<Stmt *> statements,
+                      const Types::Constants &pool) -> void {
+    constants = &pool;
     for (auto statement : statements)
         print(statement);
 }
@@ -33,15 +35,15 @@ auto IdPrinter::print(const std::string &str) -> void {
     out << std::string(nest_level, '\t') << str;
 }
 
-auto IdPrinter::println(const std::string& name, Lit value) -> void {
+auto IdPrinter::println(std::string_view name, Lit value) -> void {
     //out << std::string(nest_level * 4, '-');
     out << std::vformat("|{:^13}|{:^13}|{:^15}|", std::make_format_args(
-            name, std::visit(Types::Typify(), value),
+            name, Types::visit(Types::Typify(), value),
             stringify(value))) << "\n";
 }
 
-auto IdPrinter::stringify(Lit &value) -> std::string {
-    return std::visit(Types::Stringify(), value);
+auto IdPrinter::stringify(const Lit &value) -> std::string {
+    return Types::visit(Types::Stringify(), value);
 }
 
 
@@ -55,7 +57,7 @@ auto IdPrinter::visit(PrintStmt *stmt) -> void {
 }
 
 auto IdPrinter::visit(VarStmt *stmt) -> void {
-    println(stmt->name.lexeme(), stmt->name.literal());
+    println(stmt->name.lexeme(), nullptr);
     if (stmt->init)
         print(stmt->init);
 }
@@ -92,7 +94,7 @@ auto IdPrinter::visit(FunctionStmt *stmt) -> void {
 
     LocalNestLevel local_nest(nest_level);
     for (auto& param : stmt->params)
-        println(param.lexeme(), param.literal());
+        println(param.lexeme(), nullptr);
 
     for (auto statement : stmt->body)
         print(statement);
@@ -116,10 +118,11 @@ auto IdPrinter::visit(GroupingExpr *expr) -> Types::Literal {
 }
 
 auto IdPrinter::visit(LiteralExpr *expr) -> Types::Literal {
-    if (set_of_literals.contains(expr->value))
+    auto &value = (*constants)[expr->constant];
+    if (set_of_literals.contains(value))
         return nullptr;
-    println("<anonymous>", expr->value);
-    set_of_literals.insert(expr->value);
+    println("<anonymous>", value);
+    set_of_literals.insert(value);
     return nullptr;
 }
 
@@ -152,3 +155,98 @@ auto IdPrinter::visit(CallExpr *expr) -> Lit {
     print(arguments);
     return nullptr;
 }
+
+
+// flat syntax tree
+auto IdPrinter::print(const flat::Tree &code) -> void {
+    tree = &code;
+    constants = code.constants.get();
+    for (auto statement : tree->list(tree->statements))
+        print(statement);
+}
+
+auto IdPrinter::print(flat::Index index) -> void {
+    using namespace flat;
+    if (index == NONE)
+        return;
+
+    auto &node = (*tree)[index];
+    switch (node.kind) {
+    case EXPRESSION:
+    case PRINT:
+    case RETURN:
+    case GROUPING:
+    case UNARY:
+    case ASSIGN:
+        print(node.a);
+        break;
+
+    case VAR:
+        println(tree->token(node.token).lexeme(), nullptr);
+        print(node.a);
+        break;
+
+    case BLOCK: {
+        LocalNestLevel local_nest(nest_level);
+        for (auto statement : tree->list(node.a))
+            print(statement);
+        break;
+    }
+
+    case IF:
+        print(node.a);
+        {
+            LocalNestLevel branch_nest(nest_level);
+            print(node.b);
+        }
+        if (node.c != NONE) {
+            LocalNestLevel branch_nest(nest_level);
+            print(node.c);
+        }
+        break;
+
+    case WHILE: {
+        print(node.a);
+        LocalNestLevel body_nest(nest_level);
+        print(node.b);
+        break;
+    }
+
+    case FUNCTION: {
+        FlatFunction* function = new FlatFunction(tree, index);
+        println(tree->token(node.token).lexeme(), function);
+
+        LocalNestLevel local_nest(nest_level);
+        for (Index param = 1; param <= node.a; ++param)
+            println(tree->token(node.token + param).lexeme(), nullptr);
+
+        for (auto statement : tree->list(node.b))
+            print(statement);
+        break;
+    }
+
+    case BINARY:
+    case LOGICAL:
+        print(node.a);
+        print(node.b);
+        break;
+
+    case LITERAL: {
+        auto &value = (*constants)[node.a];
+        if (set_of_literals.contains(value))
+            break;
+        println("<anonymous>", value);
+        set_of_literals.insert(value);
+        break;
+    }
+
+    case VARIABLE:
+        break;
+
+    case CALL:
+        print(node.a);
+        for (auto argument : tree->list(node.b))
+            print(argument);
+        break;
+    }
+}
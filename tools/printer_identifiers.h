@@ -6,7 +6,9 @@
 #include <vector>
 
 #include "../Parser/Expr.h"
+#include "../Parser/FlatAst.h"
 #include "../Parser/Stmt.h"
+#include "../Types/Constants.h"
 #include "../Interpreter/Interpreter.h"
 
 namespace lox::tools {
@@ -24,15 +26,18 @@ class IdPrinter : public ExprVisitor, public StmtVisitor {
 
     std::ostream &out;
     int nest_level{};
+    const Types::Constants *constants = nullptr;
+    const flat::Tree *tree = nullptr;
 
     std::unordered_set<Lit> set_of_literals;
     std::vector<std::pair<std::string, Lit>> natives;
 
-    auto stringify(Lit &lit) -> std::string;
+    auto stringify(const Lit &lit) -> std::string;
     auto print(const std::string &name) -> void;
-    auto println(const std::string& name, Lit value) -> void;
+    auto println(std::string_view name, Lit value) -> void;
     auto print(Stmt *stmt) -> void;
     auto print(Expr *expr) -> void;
+    auto print(flat::Index node) -> void;
 
 
   public:
@@ -44,8 +49,10 @@ class IdPrinter : public ExprVisitor, public StmtVisitor {
         natives.push_back({"type", new TypeCallable()});
     }
 
-    auto print(std::vector<Stmt *> statements) -> void;
+    auto print(std::vector<Stmt *> statements, const Types::Constants &pool)
+        -> void;
     auto print(std::vector<Expr *> statements) -> void;
+    auto print(const flat::Tree &tree) -> void;
     auto print_natives() -> void;
 
     auto visit(BinaryExpr *expr) -> Lit override;